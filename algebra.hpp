@@ -0,0 +1,120 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include "matrix.hpp"
+#include "quaternion.hpp"
+
+#include <ostream>
+
+/**
+  Element \f$ \vec p \cdot \vec \sigma \f$ of the su(2) algebra.
+
+  Hermitian and traceless 2×2 matrices are fixed by their three real coefficients
+  with respect to the Pauli matrices, so only those are stored (24 bytes instead of
+  64 for a full `Matrix`). The real type is a template parameter like for
+  `BasicQuaternion`.
+  */
+template <typename Real>
+class BasicAlgebra {
+  public:
+    using real_type = Real;
+
+    BasicAlgebra() : data{0, 0, 0} {}
+
+    BasicAlgebra(Real const p1, Real const p2, Real const p3) : data{p1, p2, p3} {}
+
+    /**
+      Converts from an algebra element of another precision.
+      */
+    template <typename Other>
+    explicit BasicAlgebra(BasicAlgebra<Other> const &other)
+        : data{static_cast<Real>(other[0]), static_cast<Real>(other[1]),
+               static_cast<Real>(other[2])} {}
+
+    /**
+      Projects a 2×2 complex matrix onto the Hermitian traceless matrices.
+
+      For an element of su(2) this is exact.
+      */
+    template <typename Derived>
+    BasicAlgebra(Eigen::MatrixBase<Derived> const &mat) {
+        Matrix const m = mat;
+        data[0] = 0.5 * (m(0, 1).real() + m(1, 0).real());
+        data[1] = 0.5 * (m(1, 0).imag() - m(0, 1).imag());
+        data[2] = 0.5 * (m(0, 0).real() - m(1, 1).real());
+    }
+
+    Real &operator[](int const i) { return data[i]; }
+    Real const &operator[](int const i) const { return data[i]; }
+
+    Matrix to_matrix() const {
+        Matrix m;
+        m << Complex{data[2], 0.0}, Complex{data[0], -data[1]},
+            Complex{data[0], data[1]}, Complex{-data[2], 0.0};
+        return m;
+    }
+
+    operator Matrix() const { return to_matrix(); }
+
+    /**
+      The pure quaternion \f$ i \vec p \cdot \vec \sigma \f$, the argument of the
+      exponential that maps onto the group.
+      */
+    BasicQuaternion<Real> times_imag_unit() const {
+        return BasicQuaternion<Real>(0, data[0], data[1], data[2]);
+    }
+
+    /**
+      Sum of the squared coefficients, this is \f$ \operatorname{tr}(P^2) / 2 \f$.
+      */
+    Real norm_squared() const {
+        return data[0] * data[0] + data[1] * data[1] + data[2] * data[2];
+    }
+
+    BasicAlgebra &operator+=(BasicAlgebra const &other) {
+        for (int i = 0; i < 3; ++i) {
+            data[i] += other.data[i];
+        }
+        return *this;
+    }
+
+    BasicAlgebra &operator*=(Real const factor) {
+        for (int i = 0; i < 3; ++i) {
+            data[i] *= factor;
+        }
+        return *this;
+    }
+
+  private:
+    Real data[3];
+};
+
+/**
+  Algebra element for the momenta.
+  */
+using Algebra = BasicAlgebra<double>;
+
+/**
+  Algebra element for the momenta in the single precision molecular dynamics.
+  */
+using SingleAlgebra = BasicAlgebra<float>;
+
+template <typename Real>
+BasicAlgebra<Real> operator+(BasicAlgebra<Real> lhs, BasicAlgebra<Real> const &rhs) {
+    return lhs += rhs;
+}
+
+/// The factor is converted to the precision of the algebra element.
+template <typename Real>
+BasicAlgebra<Real> operator*(typename BasicAlgebra<Real>::real_type const factor,
+                             BasicAlgebra<Real> a) {
+    return a *= factor;
+}
+
+template <typename Real>
+std::ostream &operator<<(std::ostream &os, BasicAlgebra<Real> const &a) {
+    return os << a.to_matrix();
+}
@@ -0,0 +1,282 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Autocorrelation and errors of the time series that `su2-hmc` writes.
+///
+///     su2-analysis [options] file[:column]...
+///
+/// Columns of tsv files are counted from 0, the default is 1 if there are at
+/// least two columns (the first is the trajectory) and 0 otherwise. For
+/// `metrics.jsonl` the column is a key, the default is `plaquette`. ΔH from
+/// `boltzmann.tsv` or the `delta_h` key is analyzed as exp(−ΔH) as well, which
+/// has to average to one.
+///
+/// Options:
+///
+///  - `--skip n`: Drop the first n values for thermalization, default 0.
+///  - `--bin n`: Bin size for jackknife and bootstrap, by default the smallest
+///    one that is at least ten times the integrated autocorrelation time.
+///  - `--samples n`: Bootstrap samples, default 1000.
+///  - `--seed n`: Seed of the bootstrap, default 0.
+///  - `--s-tau s`: Factor of the automatic windowing, default 1.5.
+
+#include "statistics.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int skip = 0;
+    int bin_size = 0;
+    int samples = 1000;
+    std::uint32_t seed = 0;
+    double s_tau = 1.5;
+    std::vector<std::string> series;
+};
+
+struct Series {
+    std::string name;
+    std::vector<double> values;
+};
+
+bool ends_with(std::string const &string, std::string const &suffix) {
+    return string.size() >= suffix.size() &&
+           string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int parse_int(std::string const &text, std::string const &option) {
+    std::size_t end;
+    int value;
+    try {
+        value = std::stoi(text, &end);
+    } catch (std::logic_error const &) {
+        end = 0;
+    }
+    if (end == 0 || end != text.size()) {
+        throw std::invalid_argument("Option " + option + " needs an integer, got “" +
+                                    text + "”.");
+    }
+    return value;
+}
+
+Options parse_options(int const argc, char **const argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string const argument = argv[i];
+        if (argument.compare(0, 2, "--") != 0) {
+            options.series.push_back(argument);
+            continue;
+        }
+        if (i + 1 == argc) {
+            throw std::invalid_argument("Option " + argument + " needs a value.");
+        }
+        std::string const value = argv[++i];
+        if (argument == "--skip") {
+            options.skip = parse_int(value, argument);
+        } else if (argument == "--bin") {
+            options.bin_size = parse_int(value, argument);
+        } else if (argument == "--samples") {
+            options.samples = parse_int(value, argument);
+        } else if (argument == "--seed") {
+            options.seed = parse_int(value, argument);
+        } else if (argument == "--s-tau") {
+            options.s_tau = std::atof(value.c_str());
+        } else {
+            throw std::invalid_argument("Unknown option " + argument + ".");
+        }
+    }
+    if (options.series.empty()) {
+        throw std::invalid_argument(
+            "Usage: su2-analysis [--skip n] [--bin n] [--samples n] [--seed n] "
+            "[--s-tau s] file[:column]...");
+    }
+    if (options.skip < 0 || options.bin_size < 0) {
+        throw std::invalid_argument("--skip and --bin must not be negative.");
+    }
+    return options;
+}
+
+/**
+  One column of a tsv file, empty lines and comments are skipped.
+  */
+std::vector<double> read_tsv_column(std::string const &path, int column) {
+    std::ifstream ifs(path);
+    if (!ifs) {
+        throw std::runtime_error("Cannot open " + path + ".");
+    }
+    std::vector<double> values;
+    std::string line;
+    for (int number = 1; std::getline(ifs, line); ++number) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream iss(line);
+        std::vector<double> fields;
+        double field;
+        while (iss >> field) {
+            fields.push_back(field);
+        }
+        if (column < 0) {
+            column = fields.size() >= 2 ? 1 : 0;
+        }
+        if (column >= static_cast<int>(fields.size())) {
+            std::ostringstream message;
+            message << path << ":" << number << " has no column " << column << ".";
+            throw std::runtime_error(message.str());
+        }
+        values.push_back(fields[column]);
+    }
+    return values;
+}
+
+/**
+  The number after `"key":` in every line of a JSON lines file. `null` becomes
+  NaN.
+  */
+std::vector<double> read_jsonl_key(std::string const &path, std::string const &key) {
+    std::ifstream ifs(path);
+    if (!ifs) {
+        throw std::runtime_error("Cannot open " + path + ".");
+    }
+    std::string const pattern = "\"" + key + "\":";
+    std::vector<double> values;
+    std::string line;
+    for (int number = 1; std::getline(ifs, line); ++number) {
+        if (line.empty()) {
+            continue;
+        }
+        auto const position = line.find(pattern);
+        if (position == std::string::npos) {
+            std::ostringstream message;
+            message << path << ":" << number << " has no key " << key << ".";
+            throw std::runtime_error(message.str());
+        }
+        char const *const begin = line.c_str() + position + pattern.size();
+        char *end;
+        double const value = std::strtod(begin, &end);
+        values.push_back(end == begin ? std::nan("") : value);
+    }
+    return values;
+}
+
+/**
+  Reads `file[:column]`, drops the thermalization and values that are not finite.
+  Returns ΔH also as exp(−ΔH).
+  */
+std::vector<Series> read_series(std::string const &argument, int const skip) {
+    auto const colon = argument.rfind(':');
+    std::string const path = argument.substr(0, colon);
+    std::string const column =
+        colon == std::string::npos ? "" : argument.substr(colon + 1);
+
+    Series series;
+    series.name = argument;
+    bool delta_h;
+    if (ends_with(path, ".jsonl")) {
+        std::string const key = column.empty() ? "plaquette" : column;
+        series.values = read_jsonl_key(path, key);
+        series.name = path + ":" + key;
+        delta_h = key == "delta_h";
+    } else {
+        series.values = read_tsv_column(
+            path, column.empty() ? -1 : parse_int(column, "column of " + path));
+        delta_h = ends_with(path, "boltzmann.tsv");
+    }
+
+    if (skip >= static_cast<int>(series.values.size())) {
+        throw std::runtime_error(series.name + " has no values after the first " +
+                                 std::to_string(skip) + ".");
+    }
+    series.values.erase(series.values.begin(), series.values.begin() + skip);
+
+    int dropped = 0;
+    std::vector<double> finite;
+    for (double const value : series.values) {
+        if (std::isfinite(value)) {
+            finite.push_back(value);
+        } else {
+            ++dropped;
+        }
+    }
+    if (dropped > 0) {
+        std::cerr << series.name << ": dropped " << dropped
+                  << " values that are not finite.\n";
+    }
+    series.values = finite;
+
+    std::vector<Series> result = {series};
+    if (delta_h) {
+        Series boltzmann;
+        boltzmann.name = "exp(-ΔH) of " + series.name;
+        for (double const value : series.values) {
+            boltzmann.values.push_back(std::exp(-value));
+        }
+        result.push_back(boltzmann);
+    }
+    return result;
+}
+
+void analyze(Series const &series, Options const &options) {
+    int const size = series.values.size();
+    GammaResult const gamma = gamma_method(series.values, options.s_tau);
+
+    std::cout << series.name << ", " << size << " values\n";
+    std::cout << std::setprecision(10) << "  mean       " << gamma.mean << " ± "
+              << std::setprecision(3) << gamma.error << " (Γ-method)\n";
+    std::cout << "  tau_int    " << gamma.tau_int << " ± " << gamma.tau_int_error
+              << ", window " << gamma.window << "\n";
+
+    int const bin_size =
+        options.bin_size > 0
+            ? options.bin_size
+            : std::max(1, static_cast<int>(std::ceil(10 * gamma.tau_int)));
+    if (size / bin_size < 2) {
+        std::cout << "  Too few values for bins of " << bin_size << ".\n\n";
+        return;
+    }
+    ErrorEstimate const jackknife = binned_jackknife(series.values, bin_size);
+    ErrorEstimate const bootstrap =
+        binned_bootstrap(series.values, bin_size, options.samples, options.seed);
+    std::cout << "  jackknife  " << jackknife.error << " with bins of " << bin_size
+              << "\n";
+    std::cout << "  bootstrap  " << bootstrap.error << " with bins of " << bin_size
+              << ", " << options.samples << " samples\n";
+
+    // The binned error grows with the bin size until the bins are independent.
+    if (size >= 16) {
+        std::cout << "  bin size   jackknife error\n";
+    }
+    for (int bin = 1; size / bin >= 16; bin *= 2) {
+        std::cout << "  " << std::setw(8) << std::left << bin << "   "
+                  << binned_jackknife(series.values, bin).error << "\n";
+    }
+    std::cout << std::right << "\n";
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    try {
+        Options const options = parse_options(argc, argv);
+        for (auto const &argument : options.series) {
+            for (auto const &series : read_series(argument, options.skip)) {
+                analyze(series, options);
+            }
+        }
+    } catch (std::invalid_argument const &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (std::runtime_error const &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
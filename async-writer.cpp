@@ -0,0 +1,79 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "async-writer.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+AsyncWriter::AsyncWriter(int const capacity)
+    : capacity(capacity), busy(false), stopping(false) {
+    if (capacity < 1) {
+        throw std::invalid_argument("The output queue needs room for one job.");
+    }
+    thread = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    thread.join();
+}
+
+void AsyncWriter::submit(std::function<void()> job) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() {
+        return error || static_cast<int>(jobs.size()) < capacity;
+    });
+    rethrow_error();
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    changed.notify_all();
+}
+
+void AsyncWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return error || (jobs.empty() && !busy); });
+    rethrow_error();
+}
+
+void AsyncWriter::rethrow_error() {
+    if (error) {
+        std::exception_ptr const pending = error;
+        error = nullptr;
+        std::rethrow_exception(pending);
+    }
+}
+
+void AsyncWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            return;
+        }
+
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+        changed.notify_all();
+
+        std::exception_ptr job_error;
+        try {
+            job();
+        } catch (...) {
+            job_error = std::current_exception();
+        }
+
+        lock.lock();
+        busy = false;
+        if (job_error) {
+            error = job_error;
+            jobs.clear();
+        }
+        changed.notify_all();
+    }
+}
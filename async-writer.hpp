@@ -0,0 +1,62 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+  Runs output jobs on a background thread, in the order they were submitted.
+
+  The jobs have to own the data they write, for instance a copy of the links, such
+  that the caller can continue to change its own. At most `capacity` jobs wait in
+  the queue; only when the file system falls that far behind does `submit` block.
+
+  When a job throws, the remaining ones are dropped and the exception is rethrown
+  from the next call of `submit` or `wait`.
+  */
+class AsyncWriter {
+  public:
+    explicit AsyncWriter(int const capacity);
+
+    /**
+      Finishes all submitted jobs and stops the thread. Errors are lost, call
+      `wait` before to see them.
+      */
+    ~AsyncWriter();
+
+    AsyncWriter(AsyncWriter const &) = delete;
+    AsyncWriter &operator=(AsyncWriter const &) = delete;
+
+    /**
+      Queues a job, blocks while the queue is full.
+      */
+    void submit(std::function<void()> job);
+
+    /**
+      Blocks until all submitted jobs have finished.
+      */
+    void wait();
+
+  private:
+    void run();
+    void rethrow_error();
+
+    int const capacity;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::function<void()>> jobs;
+    bool busy;
+    bool stopping;
+    std::exception_ptr error;
+
+    /// Started last, after everything it uses is initialized.
+    std::thread thread;
+};
@@ -0,0 +1,219 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "harness.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/// Doubles per STREAM array, 128 MiB each.
+size_t constexpr stream_size = size_t(1) << 24;
+
+#ifdef __linux__
+std::uint64_t const hardware_events[] = {PERF_COUNT_HW_CPU_CYCLES,
+                                         PERF_COUNT_HW_INSTRUCTIONS,
+                                         PERF_COUNT_HW_CACHE_MISSES};
+int constexpr events = 3;
+
+int open_counter(std::uint64_t const event) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // The calling thread on any CPU.
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+}  // namespace
+
+int set_threads(int const threads) {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+    return threads;
+#else
+    return 1;
+#endif
+}
+
+void lattices_and_threads(benchmark::internal::Benchmark *benchmark) {
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (int length = 4; length <= 32; length *= 2) {
+        for (int const threads : thread_counts) {
+            benchmark->Args({length, threads});
+        }
+    }
+    benchmark->ArgNames({"L", "threads"});
+}
+
+double get_stream_bandwidth(int const threads) {
+    static std::map<int, double> cache;
+    auto const cached = cache.find(threads);
+    if (cached != cache.end()) {
+        return cached->second;
+    }
+
+    set_threads(threads);
+    std::vector<double> a(stream_size), b(stream_size), c(stream_size);
+    long const size = stream_size;
+    // First touch by the threads that use the memory later.
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < size; ++i) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+
+    double best = 0.0;
+    for (int repetition = 0; repetition < 5; ++repetition) {
+        auto const begin = std::chrono::steady_clock::now();
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < size; ++i) {
+            a[i] = b[i] + 3.0 * c[i];
+        }
+        std::chrono::duration<double> const elapsed =
+            std::chrono::steady_clock::now() - begin;
+        benchmark::DoNotOptimize(a.data());
+        best = std::max(best, 3 * sizeof(double) * stream_size / elapsed.count());
+    }
+
+    cache[threads] = best;
+    return best;
+}
+
+void set_link_counters(benchmark::State &state,
+                       double const links_per_iteration,
+                       LinkCost const &cost,
+                       int const threads,
+                       double const seconds) {
+    using benchmark::Counter;
+    auto const rate = Counter::kIsIterationInvariantRate;
+    double const bytes = links_per_iteration * cost.bytes;
+    state.counters["links"] = Counter(links_per_iteration, rate);
+    state.counters["bytes"] = Counter(bytes, rate);
+    state.counters["flops"] = Counter(links_per_iteration * cost.flops, rate);
+    state.counters["stream"] =
+        bytes * state.iterations() / seconds / get_stream_bandwidth(threads);
+}
+
+bool HardwareCounters::requested = false;
+
+HardwareCounters::HardwareCounters(int const threads) {
+#ifdef __linux__
+    if (!requested) {
+        return;
+    }
+
+    int error = 0;
+#pragma omp parallel num_threads(threads)
+    {
+        int opened[events];
+        int opened_error = 0;
+        for (int event = 0; event < events; ++event) {
+            opened[event] = open_counter(hardware_events[event]);
+            if (opened[event] < 0) {
+                opened_error = errno;
+            }
+        }
+        // The events of a thread stay together, event i is at i modulo `events`.
+#pragma omp critical
+        {
+            descriptors.insert(descriptors.end(), opened, opened + events);
+            if (opened_error != 0) {
+                error = opened_error;
+            }
+        }
+    }
+
+    if (error != 0) {
+        static bool warned = false;
+        if (!warned) {
+            std::cerr << "Hardware counters are not available: " << std::strerror(error)
+                      << std::endl;
+            warned = true;
+        }
+        for (int const descriptor : descriptors) {
+            if (descriptor >= 0) {
+                close(descriptor);
+            }
+        }
+        descriptors.clear();
+    }
+#endif
+}
+
+HardwareCounters::~HardwareCounters() {
+#ifdef __linux__
+    for (int const descriptor : descriptors) {
+        close(descriptor);
+    }
+#endif
+}
+
+void HardwareCounters::start() {
+#ifdef __linux__
+    for (int const descriptor : descriptors) {
+        ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+        ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void HardwareCounters::stop() {
+#ifdef __linux__
+    for (int const descriptor : descriptors) {
+        ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+}
+
+void HardwareCounters::report(benchmark::State &state,
+                              double const links_per_iteration) const {
+#ifdef __linux__
+    if (descriptors.empty()) {
+        return;
+    }
+
+    double totals[events] = {0.0, 0.0, 0.0};
+    for (size_t i = 0; i < descriptors.size(); ++i) {
+        std::uint64_t value = 0;
+        if (read(descriptors[i], &value, sizeof(value)) == sizeof(value)) {
+            totals[i % events] += value;
+        }
+    }
+
+    double const links = links_per_iteration * state.iterations();
+    state.counters["cycles"] = totals[0] / links;
+    state.counters["instructions"] = totals[1] / links;
+    state.counters["cache-misses"] = totals[2] / links;
+    state.counters["IPC"] = totals[1] / totals[0];
+#endif
+}
@@ -0,0 +1,119 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Measurement helpers for the kernel benchmarks: the cost model per link, the
+/// memory bandwidth ceiling and the optional hardware counters.
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+  Cost of one kernel per link and sweep.
+
+  The bytes are the minimal memory traffic, every field that the kernel touches is
+  read or written once per sweep. The floating point operations are the additions
+  and multiplications of the quaternion algebra, a square root, exponential, sine
+  or cosine counts as one.
+  */
+struct LinkCost {
+    double bytes;
+    double flops;
+};
+
+/**
+  Sets the number of OpenMP threads for the following sweeps.
+
+  \returns Number of threads that are actually used, one without OpenMP.
+  */
+int set_threads(int const threads);
+
+/**
+  Lattice extents and thread counts for the kernels: L⁴ lattices from 4⁴ to 32⁴,
+  each with 1, 2, 4, … threads up to the number that OpenMP would use.
+  */
+void lattices_and_threads(benchmark::internal::Benchmark *benchmark);
+
+/**
+  Memory bandwidth from the STREAM triad \f$ a = b + s c \f$ on arrays much larger
+  than the caches, the best of several repetitions, in bytes per second.
+
+  The result is cached per number of threads.
+  */
+double get_stream_bandwidth(int const threads);
+
+/**
+  Sets the throughput counters of a kernel benchmark after its loop: `links`,
+  `bytes` and `flops` per second, the latter two from the cost model, and `stream`,
+  the fraction of the bandwidth ceiling that the bytes reach.
+
+  \param seconds Wall clock time of the whole loop.
+  */
+void set_link_counters(benchmark::State &state,
+                       double const links_per_iteration,
+                       LinkCost const &cost,
+                       int const threads,
+                       double const seconds);
+
+/**
+  Cycles, instructions and cache misses of the OpenMP threads, counted with
+  `perf_event_open` while a benchmark loop runs.
+
+  Every thread of the team opens its own counters, the OpenMP runtime keeps the
+  same threads for the loop. Without the request, on other systems than Linux or
+  if the kernel refuses, nothing is counted and no counters are reported.
+  */
+class HardwareCounters {
+  public:
+    /// Set by `--hardware-counters` on the command line.
+    static bool requested;
+
+    explicit HardwareCounters(int const threads);
+    ~HardwareCounters();
+
+    HardwareCounters(HardwareCounters const &) = delete;
+    HardwareCounters &operator=(HardwareCounters const &) = delete;
+
+    void start();
+    void stop();
+
+    /**
+      Adds `cycles`, `instructions` and `cache-misses` per link and the
+      instructions per cycle `IPC` to the counters of the benchmark.
+      */
+    void report(benchmark::State &state, double const links_per_iteration) const;
+
+  private:
+    /// Descriptors of the events, `events` per thread.
+    std::vector<int> descriptors;
+};
+
+/**
+  Runs the benchmark loop over `sweep` and sets the counters of the benchmark.
+
+  \param links_per_iteration Links that one call of `sweep` updates or reads.
+  */
+template <typename Sweep>
+void run_sweeps(benchmark::State &state,
+                int const threads,
+                double const links_per_iteration,
+                LinkCost const &cost,
+                Sweep const &sweep) {
+    HardwareCounters counters(threads);
+    counters.start();
+    auto const begin = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        sweep();
+        benchmark::ClobberMemory();
+    }
+    std::chrono::duration<double> const elapsed =
+        std::chrono::steady_clock::now() - begin;
+    counters.stop();
+
+    set_link_counters(state, links_per_iteration, cost, threads, elapsed.count());
+    counters.report(state, links_per_iteration);
+}
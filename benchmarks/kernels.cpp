@@ -0,0 +1,178 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "harness.hpp"
+
+#include "../hybrid-monte-carlo.hpp"
+#include "../integrator.hpp"
+#include "../parallel.hpp"
+
+#include <cmath>
+
+namespace {
+
+double const beta = 2.3;
+double const time_step = 0.1;
+int const md_steps = 10;
+
+/// Floating point operations of a quaternion product.
+double constexpr product_flops = 28;
+
+/// Six staples per link, each two products and a sum.
+double constexpr staples_flops = 6 * (2 * product_flops + 4);
+
+/// Product with the link and scaling of the three components.
+double constexpr derivative_flops = staples_flops + product_flops + 3;
+
+/// Scaling of the momentum, the exponential and the product with the old link.
+double constexpr new_link_flops = 3 + 15 + product_flops;
+
+int get_links(int const length) {
+    return 4 * length * length * length * length;
+}
+
+/**
+  Molecular dynamics cost per link and step with leapfrog: one force with the
+  momentum update and one link update.
+  */
+template <typename Links, typename Momenta>
+LinkCost get_md_step_cost() {
+    double const link = sizeof(typename Links::value_type);
+    double const momentum = sizeof(typename Momenta::value_type);
+    return {link + 2 * momentum + 2 * link + momentum,
+            derivative_flops + 7 + new_link_flops};
+}
+}  // namespace
+
+void BM_get_staples(benchmark::State &state) {
+    int const length = state.range(0);
+    int const threads = set_threads(state.range(1));
+    Configuration const links = make_hot_start(length, length, 0.2, 0);
+    Configuration staples(length, length);
+
+    double const link = sizeof(Quaternion);
+    run_sweeps(state, threads, get_links(length), {2 * link, staples_flops}, [&]() {
+        parallel_region([&]() {
+#pragma omp for schedule(static)
+            for (int site = 0; site < links.get_volume(); ++site) {
+                for (int mu = 0; mu < 4; ++mu) {
+                    staples(site, mu) = get_staples(site, mu, links);
+                }
+            }
+        });
+    });
+}
+BENCHMARK(BM_get_staples)->Apply(lattices_and_threads)->UseRealTime();
+
+void BM_compute_momentum_derivative(benchmark::State &state) {
+    int const length = state.range(0);
+    int const threads = set_threads(state.range(1));
+    Configuration const links = make_hot_start(length, length, 0.2, 0);
+    MomentumConfiguration derivatives(length, length);
+
+    LinkCost const cost = {sizeof(Quaternion) + sizeof(Algebra), derivative_flops};
+    run_sweeps(state, threads, get_links(length), cost, [&]() {
+        parallel_region([&]() {
+#pragma omp for schedule(static)
+            for (int site = 0; site < links.get_volume(); ++site) {
+                for (int mu = 0; mu < 4; ++mu) {
+                    derivatives(site, mu) =
+                        compute_momentum_derivative(site, mu, links, beta);
+                }
+            }
+        });
+    });
+}
+BENCHMARK(BM_compute_momentum_derivative)->Apply(lattices_and_threads)->UseRealTime();
+
+void BM_compute_new_link(benchmark::State &state) {
+    int const length = state.range(0);
+    int const threads = set_threads(state.range(1));
+    Configuration const links = make_hot_start(length, length, 0.2, 0);
+    Configuration new_links(length, length);
+    MomentumConfiguration momenta(length, length);
+    randomize_algebra(momenta, CounterRng(0, CounterRng::Purpose::momenta, 0), 1.0);
+
+    LinkCost const cost = {2 * sizeof(Quaternion) + sizeof(Algebra), new_link_flops};
+    run_sweeps(state, threads, get_links(length), cost, [&]() {
+        parallel_region([&]() {
+#pragma omp for schedule(static)
+            for (int site = 0; site < links.get_volume(); ++site) {
+                for (int mu = 0; mu < 4; ++mu) {
+                    new_links(site, mu) =
+                        compute_new_link(site, mu, links, momenta, time_step);
+                }
+            }
+        });
+    });
+}
+BENCHMARK(BM_compute_new_link)->Apply(lattices_and_threads)->UseRealTime();
+
+void BM_get_plaquette_trace_sum(benchmark::State &state) {
+    int const length = state.range(0);
+    int const threads = set_threads(state.range(1));
+    Configuration const links = make_hot_start(length, length, 0.2, 0);
+
+    // Six plaquettes of three products per site, 1.5 per link.
+    LinkCost const cost = {sizeof(Quaternion), 1.5 * (3 * product_flops + 1)};
+    run_sweeps(state, threads, get_links(length), cost, [&]() {
+        benchmark::DoNotOptimize(get_plaquette_trace_sum(links));
+    });
+}
+BENCHMARK(BM_get_plaquette_trace_sum)->Apply(lattices_and_threads)->UseRealTime();
+
+void BM_get_momentum_energy(benchmark::State &state) {
+    int const length = state.range(0);
+    int const threads = set_threads(state.range(1));
+    MomentumConfiguration momenta(length, length);
+    randomize_algebra(momenta, CounterRng(0, CounterRng::Purpose::momenta, 0), 1.0);
+
+    run_sweeps(state, threads, get_links(length), {sizeof(Algebra), 6}, [&]() {
+        benchmark::DoNotOptimize(get_momentum_energy(momenta, beta));
+    });
+}
+BENCHMARK(BM_get_momentum_energy)->Apply(lattices_and_threads)->UseRealTime();
+
+/**
+  A whole leapfrog trajectory including the energies, the counters refer to the
+  link updates of all steps. The fields of the molecular dynamics are kept across
+  the trajectories like in the chain.
+  */
+void BM_md_evolution(benchmark::State &state,
+                     Layout const layout,
+                     Precision const precision) {
+    int const length = state.range(0);
+    int const threads = set_threads(state.range(1));
+    Configuration const links = make_hot_start(length, length, 0.2, 0);
+    Configuration proposal(length, length);
+    MomentumConfiguration momenta(length, length);
+    auto const integrator = make_integrator("leapfrog");
+    double const plaquette_trace_sum = get_plaquette_trace_sum(links).real();
+    MdState md_state(proposal, momenta, beta, layout, precision);
+
+    LinkCost const cost =
+        precision == Precision::mixed
+            ? get_md_step_cost<SingleConfiguration, SingleMomentumConfiguration>()
+            : get_md_step_cost<Configuration, MomentumConfiguration>();
+    int trajectory = 0;
+    run_sweeps(state, threads, md_steps * get_links(length), cost, [&]() {
+        randomize_algebra(
+            momenta, CounterRng(0, CounterRng::Purpose::momenta, trajectory++),
+            std::sqrt(0.5));
+        double proposal_plaquette_trace_sum;
+        benchmark::DoNotOptimize(md_evolution(md_state, links, *integrator, time_step,
+                                              md_steps, plaquette_trace_sum,
+                                              proposal_plaquette_trace_sum));
+    });
+}
+BENCHMARK_CAPTURE(BM_md_evolution, double, Layout::array_of_structures, Precision::full)
+    ->Apply(lattices_and_threads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_md_evolution, soa, Layout::structure_of_arrays, Precision::full)
+    ->Apply(lattices_and_threads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_md_evolution, mixed, Layout::array_of_structures, Precision::mixed)
+    ->Apply(lattices_and_threads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,42 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "harness.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+int main(int argc, char **argv) {
+    // Our own option is removed before the library parses the rest.
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--hardware-counters") {
+            HardwareCounters::requested = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    std::ostringstream ceiling;
+    ceiling << get_stream_bandwidth(threads) / 1e9 << " GB/s with " << threads
+            << " threads";
+    benchmark::AddCustomContext("stream_triad", ceiling.str());
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+}
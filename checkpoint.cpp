@@ -0,0 +1,221 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "checkpoint.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+char const magic[] = "su2-hmc-checkpoint";
+int const version = 1;
+
+void sync_file(std::string const &path) {
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0 || ::fsync(fd) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("Could not synchronize “" + path + "” to disk.");
+    }
+    ::close(fd);
+}
+
+/**
+  Directory that contains the file, its entries are changed by a rename.
+  */
+std::string get_directory(std::string const &path) {
+    auto const slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+void expect(std::istream &is, std::string const &keyword, std::string const &path) {
+    std::string word;
+    is >> word;
+    if (!is || word != keyword) {
+        throw std::runtime_error("Checkpoint “" + path + "” is malformed, expected “" +
+                                 keyword + "”.");
+    }
+}
+
+/**
+  Keyword and length in a line, followed by the text which may contain newlines.
+  */
+void write_block(std::ostream &os, std::string const &keyword, std::string const &text) {
+    os << keyword << " " << text.size() << "\n" << text << "\n";
+}
+
+std::string read_block(std::istream &is,
+                       std::string const &keyword,
+                       std::string const &path) {
+    size_t size;
+    expect(is, keyword, path);
+    is >> size;
+    is.ignore(1);
+    std::string text(size, '\0');
+    is.read(&text[0], size);
+    return text;
+}
+}  // namespace
+
+void save_checkpoint(std::string const &path,
+                     ChainState const &state,
+                     Configuration const &links) {
+    std::string const temporary = path + ".tmp";
+    {
+        std::ofstream os(temporary, std::ios::out | std::ios::binary);
+
+        // Text header with the counters and random states, followed by the raw
+        // links.
+        os << magic << " " << version << "\n";
+        os << "length_space " << links.length_space << "\n";
+        os << "length_time " << links.length_time << "\n";
+        os << "number_computed " << state.number_computed << "\n";
+        os << "number_accepted " << state.number_accepted << "\n";
+        os << "number_stored " << state.number_stored << "\n";
+        os << "finished " << state.finished << "\n";
+        os << "parameters " << state.parameters.size() << "\n";
+        for (auto const &entry : state.parameters) {
+            os << entry.first << " " << entry.second << "\n";
+        }
+        os << "engine " << state.engine << "\n";
+        os << "uniform " << state.uniform << "\n";
+        write_block(os, "analysis_state", state.analysis_state);
+        write_block(os, "tuning_state", state.tuning_state);
+        os << "output_sizes " << state.output_sizes.size() << "\n";
+        for (auto const &entry : state.output_sizes) {
+            os << entry.first << " " << entry.second << "\n";
+        }
+        os << "measured_trajectories " << state.measured_trajectories.size() << "\n";
+        for (auto const &entry : state.measured_trajectories) {
+            os << entry.first << " " << entry.second << "\n";
+        }
+        os << "links\n";
+        links.save(os);
+
+        os.close();
+        if (!os) {
+            throw std::runtime_error("Could not write checkpoint “" + temporary + "”.");
+        }
+    }
+
+    sync_file(temporary);
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not rename checkpoint to “" + path + "”.");
+    }
+    sync_file(get_directory(path));
+}
+
+void load_checkpoint(std::string const &path, ChainState &state, Configuration &links) {
+    std::ifstream is(path, std::ios::in | std::ios::binary);
+    if (!is) {
+        throw std::runtime_error("Could not open checkpoint “" + path + "”.");
+    }
+
+    int file_version;
+    expect(is, magic, path);
+    is >> file_version;
+    if (file_version != version) {
+        throw std::runtime_error("Checkpoint “" + path + "” has unknown version.");
+    }
+
+    int length_space, length_time;
+    expect(is, "length_space", path);
+    is >> length_space;
+    expect(is, "length_time", path);
+    is >> length_time;
+    if (length_space != links.length_space || length_time != links.length_time) {
+        throw std::runtime_error("Checkpoint “" + path +
+                                 "” has different lattice extents.");
+    }
+
+    expect(is, "number_computed", path);
+    is >> state.number_computed;
+    expect(is, "number_accepted", path);
+    is >> state.number_accepted;
+    expect(is, "number_stored", path);
+    is >> state.number_stored;
+    expect(is, "finished", path);
+    is >> state.finished;
+
+    size_t parameter_count;
+    expect(is, "parameters", path);
+    is >> parameter_count;
+    state.parameters.clear();
+    for (size_t i = 0; i < parameter_count; ++i) {
+        std::string name, value;
+        is >> name >> value;
+        state.parameters[name] = value;
+    }
+    expect(is, "engine", path);
+    is >> state.engine;
+    expect(is, "uniform", path);
+    is >> state.uniform;
+
+    state.analysis_state = read_block(is, "analysis_state", path);
+    state.tuning_state = read_block(is, "tuning_state", path);
+
+    size_t output_count;
+    expect(is, "output_sizes", path);
+    is >> output_count;
+    state.output_sizes.clear();
+    for (size_t i = 0; i < output_count; ++i) {
+        std::string name;
+        std::uintmax_t size;
+        is >> name >> size;
+        state.output_sizes[name] = size;
+    }
+
+    size_t measured_count;
+    expect(is, "measured_trajectories", path);
+    is >> measured_count;
+    state.measured_trajectories.clear();
+    for (size_t i = 0; i < measured_count; ++i) {
+        std::string name;
+        int trajectory;
+        is >> name >> trajectory;
+        state.measured_trajectories[name] = trajectory;
+    }
+
+    expect(is, "links", path);
+    is.ignore(1);
+    links.load(is);
+
+    if (!is) {
+        throw std::runtime_error("Checkpoint “" + path + "” is truncated.");
+    }
+}
+
+void check_parameters(ChainParameters const &recorded, ChainParameters const &current) {
+    std::string differences;
+    auto const add = [&](std::string const &name,
+                         std::string const &recorded_value,
+                         std::string const &current_value) {
+        differences += " " + name + " was “" + recorded_value + "”, is “" +
+                       current_value + "”.";
+    };
+    for (auto const &entry : recorded) {
+        auto const found = current.find(entry.first);
+        if (found == current.end()) {
+            add(entry.first, entry.second, "");
+        } else if (found->second != entry.second) {
+            add(entry.first, entry.second, found->second);
+        }
+    }
+    for (auto const &entry : current) {
+        if (recorded.find(entry.first) == recorded.end()) {
+            add(entry.first, "", entry.second);
+        }
+    }
+    if (!differences.empty()) {
+        throw std::runtime_error(
+            "The checkpoint belongs to a run with other parameters:" + differences);
+    }
+}
@@ -0,0 +1,92 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include "configuration.hpp"
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+
+/**
+  Parameters of a run by name, for instance `md.beta`, with their values as text
+  without whitespace.
+  */
+using ChainParameters = std::map<std::string, std::string>;
+
+/**
+  Everything besides the links that is needed to continue a Markov chain.
+
+  The momenta and the heatbath are not part of it, they draw from the counter-based
+  generator keyed by the trajectory number.
+  */
+struct ChainState {
+    ChainState()
+        : number_computed(0),
+          number_accepted(0),
+          number_stored(0),
+          finished(false),
+          uniform(0, 1) {}
+
+    int number_computed;
+    int number_accepted;
+    int number_stored;
+
+    /// Set by the last checkpoint of a chain that has reached its end. Such a chain
+    /// is not continued.
+    bool finished;
+
+    /// Parameters of the run that produced the chain. A run with different ones
+    /// must not continue it.
+    ChainParameters parameters;
+
+    /// Random numbers for the accept-reject step.
+    std::mt19937 engine;
+    std::uniform_real_distribution<double> uniform;
+
+    /// Opaque state of the online error analysis.
+    std::string analysis_state;
+
+    /// Opaque state of the step size tuning.
+    std::string tuning_state;
+
+    /// Sizes of the output files at the time of the checkpoint. Lines written after
+    /// that are dropped on restart.
+    std::map<std::string, std::uintmax_t> output_sizes;
+
+    /// Last trajectory in each measurement file at the time of the checkpoint. The
+    /// measurements run behind the chain, so this may be before `number_computed`.
+    std::map<std::string, int> measured_trajectories;
+};
+
+/**
+  Writes a checkpoint.
+
+  The file is first written under a temporary name, synchronized to disk and then
+  renamed. The directory is synchronized as well, such that the rename survives a
+  crash. An interrupted write therefore leaves the previous checkpoint intact.
+
+  \throws std::runtime_error if the file cannot be written.
+  */
+void save_checkpoint(std::string const &path,
+                     ChainState const &state,
+                     Configuration const &links);
+
+/**
+  Reads a checkpoint written by `save_checkpoint`.
+
+  \throws std::runtime_error if the file cannot be read or the lattice extents do
+  not match those of `links`.
+  */
+void load_checkpoint(std::string const &path, ChainState &state, Configuration &links);
+
+/**
+  Compares the parameters recorded in a checkpoint with those of the current run.
+
+  \throws std::runtime_error naming every parameter that differs or is missing on
+  either side.
+  */
+void check_parameters(ChainParameters const &recorded, ChainParameters const &current);
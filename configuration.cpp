@@ -2,10 +2,16 @@
 
 #include "configuration.hpp"
 
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
-Configuration::Configuration(int const length_space, int const length_time)
+template <typename T>
+BasicConfiguration<T>::BasicConfiguration(int const length_space, int const length_time)
     : length_space(length_space),
       length_time(length_time),
       spacing_n4(4),
@@ -13,22 +19,95 @@ Configuration::Configuration(int const length_space, int const length_time)
       spacing_n2(length_space * spacing_n3),
       spacing_n1(length_space * spacing_n2),
       volume(length_space * length_space * length_space * length_time),
-      data(volume * 4) {}
+      data(volume * 4),
+      neighbors(NeighborTable::get(length_space, length_time)) {}
 
-void Configuration::save(std::string const &path) const {
+template <typename T>
+void BasicConfiguration<T>::save(std::string const &path) const {
     std::ofstream os(path, std::ios::out | std::ios::binary);
-    os.write(reinterpret_cast<char const *>(data.data()), storage_size());
+    save(os);
 }
 
-void Configuration::load(std::string const &path) {
+template <typename T>
+void BasicConfiguration<T>::load(std::string const &path) {
     std::ifstream ifs(path, std::ios::out | std::ios::binary);
-    ifs.read(reinterpret_cast<char *>(data.data()), storage_size());
+    load(ifs);
+}
+
+template <typename T>
+void BasicConfiguration<T>::save(std::ostream &os) const {
+    os.write(reinterpret_cast<char const *>(data.data()), storage_size());
+}
+
+template <typename T>
+void BasicConfiguration<T>::load(std::istream &is) {
+    is.read(reinterpret_cast<char *>(data.data()), storage_size());
+    if (!is) {
+        throw std::runtime_error("Could not read the links, the file is too short.");
+    }
+}
+
+template class BasicConfiguration<Quaternion>;
+template class BasicConfiguration<Algebra>;
+template class BasicConfiguration<SingleQuaternion>;
+template class BasicConfiguration<SingleAlgebra>;
+
+namespace {
+
+template <typename From, typename To>
+void convert_elements(BasicConfiguration<From> const &from, BasicConfiguration<To> &to) {
+    assert(from.get_size() == to.get_size());
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int i = 0; i < from.get_size(); ++i) {
+            to[i] = To(from[i]);
+        }
+    });
+}
+
+template <typename Real>
+void reunitarize_links(BasicConfiguration<BasicQuaternion<Real>> &links) {
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int i = 0; i < links.get_size(); ++i) {
+            Real const norm = std::sqrt(links[i].determinant());
+            for (int c = 0; c < 4; ++c) {
+                links[i][c] /= norm;
+            }
+        }
+    });
+}
+}  // namespace
+
+void convert(Configuration const &from, SingleConfiguration &to) {
+    convert_elements(from, to);
+}
+
+void convert(SingleConfiguration const &from, Configuration &to) {
+    convert_elements(from, to);
+}
+
+void convert(MomentumConfiguration const &from, SingleMomentumConfiguration &to) {
+    convert_elements(from, to);
+}
+
+void convert(SingleMomentumConfiguration const &from, MomentumConfiguration &to) {
+    convert_elements(from, to);
+}
+
+void reunitarize(Configuration &links) {
+    reunitarize_links(links);
+}
+
+void reunitarize(SingleConfiguration &links) {
+    reunitarize_links(links);
 }
 
 void global_gauge_transformation(Matrix const &transformation, Configuration &links) {
-    Matrix const adjoint = transformation.adjoint();
+    Quaternion const left(transformation);
+    Quaternion const right = left.adjoint();
     for (int i = 0; i < links.get_size(); ++i) {
-        links[i] = transformation * links[i] * adjoint;
+        links[i] = left * links[i] * right;
     }
 }
 
@@ -37,20 +116,20 @@ Configuration make_hot_start(int const length_space,
                              int const length_time,
                              double const std,
                              int const seed) {
-    std::mt19937 engine(seed);
-    std::normal_distribution<double> dist(0, std);
-
     Configuration links(length_space, length_time);
-    randomize_group(links, engine, dist);
+    randomize_group(links, CounterRng(seed, CounterRng::Purpose::hot_start, 0), std);
     return links;
 }
 
-void randomize_algebra(Configuration &config,
+void randomize_algebra(MomentumConfiguration &config,
                        std::mt19937 &engine,
                        std::normal_distribution<double> &dist) {
     for (int i = 0; i < config.get_size(); ++i) {
-        Matrix const next = random_from_algebra(engine, dist);
-        config[i] = next;
+        // Draw in a fixed order, the order of evaluation of arguments is unspecified.
+        Algebra &next = config[i];
+        for (int j = 0; j < 3; ++j) {
+            next[j] = dist(engine);
+        }
     }
 }
 
@@ -62,3 +141,36 @@ void randomize_group(Configuration &config,
         config[i] = next;
     }
 }
+
+void randomize_algebra(MomentumConfiguration &config,
+                       CounterRng const &rng,
+                       double const std) {
+    // Links are processed in batches such that the generator can work on many
+    // indices at once, every link takes three of its four numbers.
+    int constexpr batch = 64;
+    parallel_region([&]() {
+        double normals[4 * batch];
+#pragma omp for schedule(static)
+        for (int begin = 0; begin < config.get_size(); begin += batch) {
+            int const count = std::min(batch, config.get_size() - begin);
+            rng.fill_gaussians(begin, count, normals);
+            for (int i = 0; i < count; ++i) {
+                Algebra &next = config[begin + i];
+                for (int j = 0; j < 3; ++j) {
+                    next[j] = std * normals[4 * i + j];
+                }
+            }
+        }
+    });
+}
+
+void randomize_group(Configuration &config, CounterRng const &rng, double const std) {
+    MomentumConfiguration algebra(config.length_space, config.length_time);
+    randomize_algebra(algebra, rng, std);
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int i = 0; i < config.get_size(); ++i) {
+            config[i] = exp(algebra[i].times_imag_unit());
+        }
+    });
+}
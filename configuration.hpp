@@ -2,17 +2,31 @@
 
 #pragma once
 
+#include "algebra.hpp"
+#include "counter-rng.hpp"
 #include "matrix.hpp"
+#include "neighbor-table.hpp"
 #include "pauli-matrices.hpp"
+#include "quaternion.hpp"
 
 #include <cassert>
+#include <iosfwd>
+#include <memory>
+#include <string>
 #include <vector>
 
-class Configuration {
+/**
+  Field with one element per link of the lattice.
+
+  The element type is a template parameter such that the gauge links can be stored
+  compactly as quaternions while other link fields use a different representation.
+  */
+template <typename T>
+class BasicConfiguration {
   public:
-    using value_type = Eigen::Matrix2cd;
+    using value_type = T;
 
-    Configuration(int const length_space, int const length_time);
+    BasicConfiguration(int const length_space, int const length_time);
 
     value_type &
     operator()(int const n1, int const n2, int const n3, int const n4, int const mu) {
@@ -32,6 +46,19 @@ class Configuration {
         return data[get_index(coords[0], coords[1], coords[2], coords[3], mu)];
     }
 
+    /**
+      Access by site index, see `get_site` and `get_neighbors`.
+      */
+    value_type &operator()(int const site, int const mu) {
+        assert(0 <= site && site < volume);
+        return data[4 * site + mu];
+    }
+
+    const value_type &operator()(int const site, int const mu) const {
+        assert(0 <= site && site < volume);
+        return data[4 * site + mu];
+    }
+
     value_type &operator[](int const index) {
         return data[index];
     }
@@ -46,15 +73,39 @@ class Configuration {
     int get_volume() const { return volume; }
     int get_size() const { return data.size(); }
 
+    /**
+      Site index of the given coordinates, periodic boundary conditions apply.
+      */
+    int get_site(int const n1, int const n2, int const n3, int const n4) const {
+        return get_index(n1, n2, n3, n4, 0) / 4;
+    }
+
+    NeighborTable const &get_neighbors() const { return *neighbors; }
+
     void save(std::string const &path) const;
     void load(std::string const &path);
 
+    /**
+      Writes the raw link data to a stream, for embedding into other files.
+      */
+    void save(std::ostream &os) const;
+
+    /**
+      Reads the raw link data from a stream, the extents have to match already.
+
+      \throws std::runtime_error if the stream ends too early.
+      */
+    void load(std::istream &is);
+
 
   private:
     int spacing_n4, spacing_n3, spacing_n2, spacing_n1;
     int volume;
 
-    std::vector<value_type> data;
+    /// Eigen types with fixed size need the aligned allocator in a `std::vector`.
+    std::vector<value_type, Eigen::aligned_allocator<value_type>> data;
+
+    std::shared_ptr<NeighborTable const> neighbors;
 
     size_t get_index(
         int const n1, int const n2, int const n3, int const n4, int const mu) const {
@@ -77,12 +128,52 @@ class Configuration {
         int const index = n1_p * spacing_n1 + n2_p * spacing_n2 + n3_p * spacing_n3 +
                           n4_p * spacing_n4 + mu;
 
-        assert(0 <= index && index < data.size());
+        assert(0 <= index && index < get_size());
 
         return index;
     }
 };
 
+/**
+  Gauge links, stored as SU(2) quaternions.
+  */
+using Configuration = BasicConfiguration<Quaternion>;
+
+/**
+  Conjugate momenta, stored as the three coefficients of su(2) elements.
+  */
+using MomentumConfiguration = BasicConfiguration<Algebra>;
+
+/**
+  Gauge links in single precision, for the molecular dynamics with
+  `Precision::mixed`.
+  */
+using SingleConfiguration = BasicConfiguration<SingleQuaternion>;
+
+/**
+  Conjugate momenta in single precision.
+  */
+using SingleMomentumConfiguration = BasicConfiguration<SingleAlgebra>;
+
+/**
+  Copies a field into one of the other precision, the extents have to match.
+
+  Inside a parallel region this has to be called by all threads of the team.
+  */
+void convert(Configuration const &from, SingleConfiguration &to);
+void convert(SingleConfiguration const &from, Configuration &to);
+void convert(MomentumConfiguration const &from, SingleMomentumConfiguration &to);
+void convert(SingleMomentumConfiguration const &from, MomentumConfiguration &to);
+
+/**
+  Projects every link back onto SU(2) by normalizing the quaternion, which
+  removes the drift from accumulated rounding errors.
+
+  Inside a parallel region this has to be called by all threads of the team.
+  */
+void reunitarize(Configuration &links);
+void reunitarize(SingleConfiguration &links);
+
 void global_gauge_transformation(Matrix const &transformation, Configuration &links);
 
 /**
@@ -96,13 +187,32 @@ Configuration make_hot_start(int const length_space,
 /**
   Randomizes the whole lattice with su(2) matrices.
   */
-void randomize_algebra(Configuration &configuration,
+void randomize_algebra(MomentumConfiguration &configuration,
                        std::mt19937 &engine,
                        std::normal_distribution<double> &dist);
 
+/**
+  Randomizes the whole lattice with su(2) matrices from the counter-based
+  generator, the coefficients have standard deviation `std`.
+
+  The numbers of link `i` are those of index `i`, so this runs in parallel and
+  gives the same field for every number of threads.
+  */
+void randomize_algebra(MomentumConfiguration &configuration,
+                       CounterRng const &rng,
+                       double const std);
+
 /**
   Randomizes the whole lattice with SU(2) matrices.
   */
 void randomize_group(Configuration &configuration,
                      std::mt19937 &engine,
                      std::normal_distribution<double> &dist);
+
+/**
+  Randomizes the whole lattice with SU(2) matrices \f$ \exp(i p \cdot \sigma) \f$
+  where the coefficients \f$ p \f$ come from `randomize_algebra`.
+  */
+void randomize_group(Configuration &configuration,
+                     CounterRng const &rng,
+                     double const std);
@@ -0,0 +1,107 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+/**
+  Counter-based random number generator, Philox-4×32-10.
+
+  Salmon, Moraes, Dror, Shaw, “Parallel random numbers: as easy as 1, 2, 3”, SC11.
+  The numbers for a given index are a pure function of the seed, the purpose, the
+  stream and the index. Every link can therefore draw its numbers independently,
+  the fields do not depend on the order of the loop or the number of threads.
+  */
+class CounterRng {
+  public:
+    /**
+      What the numbers are used for, part of the key such that different uses never
+      share numbers.
+      */
+    enum class Purpose : std::uint32_t {
+        hot_start = 0,
+        momenta = 1,
+        heatbath = 2,
+        bootstrap = 3
+    };
+
+    /**
+      \param seed User seed.
+      \param purpose Use of the numbers.
+      \param stream For instance the trajectory number.
+      */
+    CounterRng(std::uint32_t const seed, Purpose const purpose, std::uint64_t const stream)
+        : key{seed, static_cast<std::uint32_t>(purpose)},
+          stream{static_cast<std::uint32_t>(stream),
+                 static_cast<std::uint32_t>(stream >> 32)} {}
+
+    /**
+      Four random 32 bit integers for the given index.
+      */
+    void generate(std::uint64_t const index, std::uint32_t *const out) const {
+        std::uint32_t counter[4] = {static_cast<std::uint32_t>(index),
+                                    static_cast<std::uint32_t>(index >> 32),
+                                    stream[0],
+                                    stream[1]};
+        std::uint32_t round_key[2] = {key[0], key[1]};
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                round_key[0] += 0x9E3779B9;
+                round_key[1] += 0xBB67AE85;
+            }
+            std::uint64_t const product0 = std::uint64_t{0xD2511F53} * counter[0];
+            std::uint64_t const product1 = std::uint64_t{0xCD9E8D57} * counter[2];
+            std::uint32_t const next[4] = {
+                static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ round_key[0],
+                static_cast<std::uint32_t>(product1),
+                static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ round_key[1],
+                static_cast<std::uint32_t>(product0)};
+            for (int i = 0; i < 4; ++i) {
+                counter[i] = next[i];
+            }
+        }
+        for (int i = 0; i < 4; ++i) {
+            out[i] = counter[i];
+        }
+    }
+
+    /**
+      Four uniformly distributed numbers in (0, 1) for the given index.
+      */
+    void uniforms(std::uint64_t const index, double *const out) const {
+        std::uint32_t bits[4];
+        generate(index, bits);
+        for (int i = 0; i < 4; ++i) {
+            out[i] = (bits[i] + 0.5) * (1.0 / 4294967296.0);
+        }
+    }
+
+    /**
+      Fills `4 * count` standard normal numbers, four for each index starting at
+      `first_index`.
+
+      The integers of a batch are generated first, then transformed with the
+      Box–Muller method. Both loops are free of dependencies between the indices.
+      */
+    void fill_gaussians(std::uint64_t const first_index,
+                        int const count,
+                        double *const out) const {
+        for (int i = 0; i < count; ++i) {
+            uniforms(first_index + i, out + 4 * i);
+        }
+        double const two_pi = 2 * std::acos(-1);
+        for (int i = 0; i < 2 * count; ++i) {
+            double const radius = std::sqrt(-2.0 * std::log(out[2 * i]));
+            double const angle = two_pi * out[2 * i + 1];
+            out[2 * i] = radius * std::cos(angle);
+            out[2 * i + 1] = radius * std::sin(angle);
+        }
+    }
+
+  private:
+    std::uint32_t key[2];
+    std::uint32_t stream[2];
+};
@@ -0,0 +1,391 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "gauge-file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(Quaternion) == 4 * sizeof(double),
+              "Quaternions are stored as four packed doubles.");
+static_assert(std::is_trivially_copyable<Quaternion>::value,
+              "Mapped quaternions are used without construction.");
+
+namespace {
+
+char const magic[] = "su2-gauge";
+int const version = 1;
+
+struct CodecName {
+    GaugeCodec codec;
+    char const *name;
+    char const *precision;
+    char const *layout;
+};
+
+CodecName const codec_names[] = {
+    {GaugeCodec::quaternion_double, "double", "double", "quaternion-site-direction"},
+    {GaugeCodec::reconstruct_double,
+     "reconstruct",
+     "double",
+     "reconstruct-largest-site-direction"},
+    {GaugeCodec::quaternion_single, "single", "single", "quaternion-site-direction"},
+    {GaugeCodec::reconstruct_single,
+     "single-reconstruct",
+     "single",
+     "reconstruct-largest-site-direction"}};
+
+CodecName const &get_codec_name(GaugeCodec const codec) {
+    for (auto const &entry : codec_names) {
+        if (entry.codec == codec) {
+            return entry;
+        }
+    }
+    assert(false);
+    return codec_names[0];
+}
+
+bool is_single(GaugeCodec const codec) {
+    return codec == GaugeCodec::quaternion_single ||
+           codec == GaugeCodec::reconstruct_single;
+}
+
+bool is_reconstruct(GaugeCodec const codec) {
+    return codec == GaugeCodec::reconstruct_double ||
+           codec == GaugeCodec::reconstruct_single;
+}
+
+std::uint64_t fnv1a(std::uint64_t const *const words, size_t const count) {
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < count; ++i) {
+        hash ^= words[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+std::uint64_t checksum(Quaternion const *const links, size_t const count) {
+    return fnv1a(reinterpret_cast<std::uint64_t const *>(links), 4 * count);
+}
+
+size_t get_links_count(GaugeFileHeader const &header) {
+    size_t const volume = static_cast<size_t>(header.length_space) *
+                          header.length_space * header.length_space *
+                          header.length_time;
+    return 4 * volume;
+}
+
+/// Bytes of the packed nibbles of the omitted components, padded to whole 64 bit
+/// words.
+size_t get_omitted_size(size_t const links_count) {
+    return (links_count + 15) / 16 * 8;
+}
+
+size_t get_data_size(GaugeCodec const codec, size_t const links_count) {
+    size_t const component_size = is_single(codec) ? sizeof(float) : sizeof(double);
+    if (is_reconstruct(codec)) {
+        return links_count * 3 * component_size + get_omitted_size(links_count);
+    }
+    return links_count * 4 * component_size;
+}
+
+size_t get_data_size(GaugeFileHeader const &header) {
+    return get_data_size(header.codec, get_links_count(header));
+}
+
+template <typename Real>
+void encode_components(Configuration const &links,
+                       GaugeCodec const codec,
+                       std::vector<std::uint64_t> &data) {
+    Real *components = reinterpret_cast<Real *>(data.data());
+    if (!is_reconstruct(codec)) {
+        for (int i = 0; i < links.get_size(); ++i) {
+            for (int c = 0; c < 4; ++c) {
+                *components++ = static_cast<Real>(links[i][c]);
+            }
+        }
+        return;
+    }
+
+    unsigned char *const omitted =
+        reinterpret_cast<unsigned char *>(components + 3 * links.get_size());
+    for (int i = 0; i < links.get_size(); ++i) {
+        // The largest component is at least 1/2 in magnitude, recomputing it from
+        // the unit norm does not amplify the rounding of the others.
+        int largest = 0;
+        for (int c = 1; c < 4; ++c) {
+            if (std::abs(links[i][c]) > std::abs(links[i][largest])) {
+                largest = c;
+            }
+        }
+        for (int c = 0; c < 4; ++c) {
+            if (c != largest) {
+                *components++ = static_cast<Real>(links[i][c]);
+            }
+        }
+        int const nibble = largest | (links[i][largest] < 0.0 ? 4 : 0);
+        omitted[i / 2] |= nibble << (4 * (i % 2));
+    }
+}
+
+template <typename Real>
+void decode_components(std::vector<std::uint64_t> const &data,
+                       GaugeCodec const codec,
+                       Configuration &links) {
+    Real const *components = reinterpret_cast<Real const *>(data.data());
+    if (!is_reconstruct(codec)) {
+        for (int i = 0; i < links.get_size(); ++i) {
+            for (int c = 0; c < 4; ++c) {
+                links[i][c] = *components++;
+            }
+        }
+        return;
+    }
+
+    unsigned char const *const omitted =
+        reinterpret_cast<unsigned char const *>(components + 3 * links.get_size());
+    for (int i = 0; i < links.get_size(); ++i) {
+        int const nibble = (omitted[i / 2] >> (4 * (i % 2))) & 15;
+        int const largest = nibble & 3;
+        double norm_squared = 0.0;
+        for (int c = 0; c < 4; ++c) {
+            if (c != largest) {
+                links[i][c] = *components++;
+                norm_squared += links[i][c] * links[i][c];
+            }
+        }
+        // Rounding can push the norm of the stored part slightly above one.
+        double const value = std::sqrt(std::max(0.0, 1.0 - norm_squared));
+        links[i][largest] = nibble & 4 ? -value : value;
+    }
+}
+
+/**
+  Stored data for the lossy codecs, in 64 bit words such that it can be checksummed
+  directly. The padding is zero.
+  */
+std::vector<std::uint64_t> encode(Configuration const &links, GaugeCodec const codec) {
+    std::vector<std::uint64_t> data(get_data_size(codec, links.get_size()) / 8, 0);
+    if (is_single(codec)) {
+        encode_components<float>(links, codec, data);
+    } else {
+        encode_components<double>(links, codec, data);
+    }
+    return data;
+}
+
+void decode(std::vector<std::uint64_t> const &data,
+            GaugeCodec const codec,
+            Configuration &links) {
+    if (is_single(codec)) {
+        decode_components<float>(data, codec, links);
+    } else {
+        decode_components<double>(data, codec, links);
+    }
+
+    // Project back onto SU(2), which removes the rounding of the stored components.
+    reunitarize(links);
+}
+
+void expect(std::istream &is, std::string const &keyword, std::string const &path) {
+    std::string word;
+    is >> word;
+    if (!is || word != keyword) {
+        throw std::runtime_error("“" + path + "” is not a valid gauge file, expected “" +
+                                 keyword + "”.");
+    }
+}
+
+GaugeFileHeader parse_header(std::string const &text, std::string const &path) {
+    std::istringstream is(text);
+    GaugeFileHeader header;
+
+    expect(is, magic, path);
+    is >> header.version;
+    if (header.version != version) {
+        throw std::runtime_error("“" + path + "” has unsupported version.");
+    }
+    expect(is, "length_space", path);
+    is >> header.length_space;
+    expect(is, "length_time", path);
+    is >> header.length_time;
+    expect(is, "precision", path);
+    is >> header.precision;
+    expect(is, "layout", path);
+    is >> header.layout;
+    expect(is, "beta", path);
+    is >> header.beta;
+    expect(is, "trajectory", path);
+    is >> header.trajectory;
+    expect(is, "checksum", path);
+    expect(is, "fnv1a64", path);
+    is >> std::hex >> header.checksum >> std::dec;
+    expect(is, "end", path);
+
+    bool found = false;
+    for (auto const &entry : codec_names) {
+        if (header.precision == entry.precision && header.layout == entry.layout) {
+            header.codec = entry.codec;
+            found = true;
+        }
+    }
+    if (!found) {
+        throw std::runtime_error("“" + path + "” has unsupported precision “" +
+                                 header.precision + "” or layout “" + header.layout +
+                                 "”.");
+    }
+    if (header.length_space <= 0 || header.length_time <= 0) {
+        throw std::runtime_error("“" + path + "” has invalid lattice extents.");
+    }
+    return header;
+}
+}  // namespace
+
+GaugeCodec parse_gauge_codec(std::string const &name) {
+    for (auto const &entry : codec_names) {
+        if (name == entry.name) {
+            return entry.codec;
+        }
+    }
+    throw std::invalid_argument("Unknown gauge file codec “" + name + "”.");
+}
+
+std::uint64_t gauge_file_checksum(Configuration const &links) {
+    return checksum(&links[0], links.get_size());
+}
+
+void save_gauge_file(std::string const &path,
+                     Configuration const &links,
+                     double const beta,
+                     int const trajectory,
+                     GaugeCodec const codec) {
+    // The lossless codec writes the links directly without an extra copy.
+    std::vector<std::uint64_t> data;
+    std::uint64_t data_checksum;
+    if (codec == GaugeCodec::quaternion_double) {
+        data_checksum = gauge_file_checksum(links);
+    } else {
+        data = encode(links, codec);
+        data_checksum = fnv1a(data.data(), data.size());
+    }
+
+    CodecName const &codec_name = get_codec_name(codec);
+    std::ostringstream header;
+    header << magic << " " << version << "\n"
+           << "length_space " << links.length_space << "\n"
+           << "length_time " << links.length_time << "\n"
+           << "precision " << codec_name.precision << "\n"
+           << "layout " << codec_name.layout << "\n"
+           << "beta " << std::setprecision(17) << beta << "\n"
+           << "trajectory " << trajectory << "\n"
+           << "checksum fnv1a64 " << std::hex << std::setw(16) << std::setfill('0')
+           << data_checksum << "\n"
+           << "end\n";
+
+    std::string text = header.str();
+    assert(text.size() < gauge_file_header_size);
+    text.resize(gauge_file_header_size - 1, ' ');
+    text += "\n";
+
+    std::ofstream os(path, std::ios::out | std::ios::binary);
+    os.write(text.data(), text.size());
+    if (codec == GaugeCodec::quaternion_double) {
+        links.save(os);
+    } else {
+        os.write(reinterpret_cast<char const *>(data.data()),
+                 data.size() * sizeof(data[0]));
+    }
+    os.close();
+    if (!os) {
+        throw std::runtime_error("Could not write gauge file “" + path + "”.");
+    }
+}
+
+GaugeFileHeader read_gauge_file_header(std::string const &path) {
+    std::ifstream is(path, std::ios::in | std::ios::binary);
+    std::string text(gauge_file_header_size, '\0');
+    is.read(&text[0], text.size());
+    if (!is) {
+        throw std::runtime_error("Could not read the header of “" + path + "”.");
+    }
+    return parse_header(text, path);
+}
+
+Configuration load_gauge_file(std::string const &path) {
+    GaugeFileHeader const header = read_gauge_file_header(path);
+
+    Configuration links(header.length_space, header.length_time);
+    std::ifstream is(path, std::ios::in | std::ios::binary);
+    is.seekg(gauge_file_header_size);
+
+    if (header.codec == GaugeCodec::quaternion_double) {
+        links.load(is);
+        if (gauge_file_checksum(links) != header.checksum) {
+            throw std::runtime_error("Checksum mismatch in “" + path + "”.");
+        }
+        return links;
+    }
+
+    std::vector<std::uint64_t> data(get_data_size(header) / 8);
+    is.read(reinterpret_cast<char *>(data.data()), data.size() * sizeof(data[0]));
+    if (!is) {
+        throw std::runtime_error("Gauge file “" + path + "” is truncated.");
+    }
+    if (fnv1a(data.data(), data.size()) != header.checksum) {
+        throw std::runtime_error("Checksum mismatch in “" + path + "”.");
+    }
+    decode(data, header.codec, links);
+    return links;
+}
+
+MappedGaugeFile::MappedGaugeFile(std::string const &path)
+    : header(read_gauge_file_header(path)),
+      neighbors(NeighborTable::get(header.length_space, header.length_time)),
+      mapping(nullptr),
+      mapping_size(gauge_file_header_size + get_data_size(header)),
+      links(nullptr) {
+    if (header.codec != GaugeCodec::quaternion_double) {
+        throw std::runtime_error("Gauge file “" + path +
+                                 "” is compressed and cannot be mapped.");
+    }
+
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open “" + path + "”.");
+    }
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0 ||
+        static_cast<size_t>(status.st_size) < mapping_size) {
+        ::close(fd);
+        throw std::runtime_error("Gauge file “" + path + "” is truncated.");
+    }
+
+    mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after closing the descriptor.
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map “" + path + "” into memory.");
+    }
+
+    links = reinterpret_cast<Quaternion const *>(static_cast<char const *>(mapping) +
+                                                 gauge_file_header_size);
+}
+
+MappedGaugeFile::~MappedGaugeFile() { ::munmap(mapping, mapping_size); }
+
+bool MappedGaugeFile::verify_checksum() const {
+    return checksum(links, 4 * static_cast<size_t>(get_volume())) == header.checksum;
+}
@@ -0,0 +1,158 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Self-describing file format for gauge configurations.
+///
+/// A file starts with a text header of `gauge_file_header_size` bytes, padded with
+/// spaces, for instance:
+///
+///     su2-gauge 1
+///     length_space 8
+///     length_time 8
+///     precision double
+///     layout quaternion-site-direction
+///     beta 2.3
+///     trajectory 100
+///     checksum fnv1a64 0123456789abcdef
+///     end
+///
+/// It is followed by the links, the direction running fastest and then the sites
+/// in the order of `Configuration`. The precision is `double` or `single`. With the
+/// layout `quaternion-site-direction` every link is stored as (a_0, a_1, a_2, a_3).
+/// With `reconstruct-largest-site-direction` the component with the largest
+/// magnitude is omitted and the other three are stored in their order. They are
+/// followed by four bits per link, two links per byte starting at the least
+/// significant bits, padded with zeros to a multiple of eight bytes. The lower two
+/// bits are the index of the omitted component and the third is set if it is
+/// negative. The omitted component is reconstructed from the unit norm, its
+/// magnitude is at least 1/2 and the rounding of the others is not amplified.
+///
+/// The checksum is 64 bit FNV-1a over the 64 bit words of the stored data.
+
+#pragma once
+
+#include "configuration.hpp"
+
+#include <cstdint>
+#include <string>
+
+/// Size of the text header, the link data starts page aligned after it.
+int constexpr gauge_file_header_size = 4096;
+
+/**
+  Encoding of the links in a gauge file.
+
+  Only `quaternion_double` is lossless and can be mapped into memory. The others
+  normalize every link to unit determinant after loading, the single precision
+  ones keep the links to about 1e-7 absolute.
+  */
+enum class GaugeCodec {
+    /// Four doubles per link, 32 bytes.
+    quaternion_double,
+    /// Three doubles and four bits per link, 24.5 bytes.
+    reconstruct_double,
+    /// Four floats per link, 16 bytes.
+    quaternion_single,
+    /// Three floats and four bits per link, 12.5 bytes.
+    reconstruct_single
+};
+
+/**
+  Codec from its name as used in the configuration: `double`, `reconstruct`,
+  `single` or `single-reconstruct`.
+
+  \throws std::invalid_argument for an unknown name.
+  */
+GaugeCodec parse_gauge_codec(std::string const &name);
+
+struct GaugeFileHeader {
+    int version;
+    int length_space;
+    int length_time;
+
+    /// Floating point type of the stored components, `double` or `single`.
+    std::string precision;
+
+    /// Order of the stored numbers, `quaternion-site-direction` or
+    /// `reconstruct-largest-site-direction`.
+    std::string layout;
+
+    /// Codec corresponding to `precision` and `layout`.
+    GaugeCodec codec;
+
+    double beta;
+    int trajectory;
+    std::uint64_t checksum;
+};
+
+/**
+  Checksum of the link data as used in the header.
+  */
+std::uint64_t gauge_file_checksum(Configuration const &links);
+
+/**
+  Writes the links with a header.
+
+  \throws std::runtime_error if the file cannot be written.
+  */
+void save_gauge_file(std::string const &path,
+                     Configuration const &links,
+                     double const beta,
+                     int const trajectory,
+                     GaugeCodec const codec = GaugeCodec::quaternion_double);
+
+/**
+  Reads only the header of a gauge file.
+
+  \throws std::runtime_error if the file cannot be read or is not a gauge file of
+  a supported version, precision and layout.
+  */
+GaugeFileHeader read_gauge_file_header(std::string const &path);
+
+/**
+  Reads a gauge file into memory and verifies its checksum.
+
+  \throws std::runtime_error if the file is malformed, truncated or corrupted.
+  */
+Configuration load_gauge_file(std::string const &path);
+
+/**
+  Read-only view of a gauge file that is mapped into memory.
+
+  Pages are only read from disk when the links are accessed, nothing is copied.
+  Only files with the codec `quaternion_double` can be mapped.
+  */
+class MappedGaugeFile {
+  public:
+    /**
+      \throws std::runtime_error if the file is malformed, truncated or compressed.
+      */
+    explicit MappedGaugeFile(std::string const &path);
+    ~MappedGaugeFile();
+
+    MappedGaugeFile(MappedGaugeFile const &) = delete;
+    MappedGaugeFile &operator=(MappedGaugeFile const &) = delete;
+
+    GaugeFileHeader const &get_header() const { return header; }
+
+    Quaternion const &operator()(int const site, int const mu) const {
+        assert(0 <= site && site < neighbors->get_volume());
+        return links[4 * site + mu];
+    }
+
+    NeighborTable const &get_neighbors() const { return *neighbors; }
+    int get_volume() const { return neighbors->get_volume(); }
+
+    /**
+      Recomputes the checksum, this reads the whole file.
+      */
+    bool verify_checksum() const;
+
+  private:
+    GaugeFileHeader header;
+    std::shared_ptr<NeighborTable const> neighbors;
+
+    void *mapping;
+    size_t mapping_size;
+    Quaternion const *links;
+};
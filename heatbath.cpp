@@ -0,0 +1,131 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "heatbath.hpp"
+
+#include "hybrid-monte-carlo.hpp"
+#include "sanity-checks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Quaternion heatbath_link(Quaternion const &staples,
+                         double const beta,
+                         LinkUniforms &uniform) {
+    double const pi = std::acos(-1);
+
+    // Write V = k W with W in SU(2). Then X = U W is distributed with
+    // sqrt(1 - x_0^2) exp(a x_0) where a = 2 β k / N since Re tr X = 2 x_0.
+    double const k = std::sqrt(staples.determinant());
+    Quaternion w = Quaternion::identity();
+    double x0;
+    if (k == 0.0) {
+        // Without staples this is the Haar measure, sample sqrt(1 - x_0^2).
+        do {
+            x0 = 2.0 * uniform() - 1.0;
+        } while (uniform() > std::sqrt(1.0 - x0 * x0));
+    } else {
+        w = (1.0 / k) * staples;
+        double const a = 2.0 * beta * k / number_of_colors;
+
+        // Kennedy, Pendleton, Phys. Lett. B 156 (1985) 393.
+        while (true) {
+            double const r1 = 1.0 - uniform();
+            double const r2 = uniform();
+            double const r3 = 1.0 - uniform();
+            double const r4 = uniform();
+            double const c = std::cos(2 * pi * r2);
+            double const lambda_sq =
+                -(std::log(r1) + c * c * std::log(r3)) / (2.0 * a);
+            if (r4 * r4 <= 1.0 - lambda_sq) {
+                x0 = 1.0 - 2.0 * lambda_sq;
+                break;
+            }
+        }
+    }
+
+    // The remaining components are uniformly distributed on a sphere.
+    double const radius = std::sqrt(std::max(0.0, 1.0 - x0 * x0));
+    double const cos_theta = 2.0 * uniform() - 1.0;
+    double const sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+    double const phi = 2 * pi * uniform();
+    Quaternion const x(x0,
+                       radius * sin_theta * std::cos(phi),
+                       radius * sin_theta * std::sin(phi),
+                       radius * cos_theta);
+
+    Quaternion const new_link = x * w.adjoint();
+    assert(is_unitary(new_link));
+    return new_link;
+}
+
+Quaternion overrelax_link(Quaternion const &link, Quaternion const &staples) {
+    double const k = std::sqrt(staples.determinant());
+    if (k == 0.0) {
+        return link;
+    }
+    Quaternion const w_adjoint = (1.0 / k) * staples.adjoint();
+    return w_adjoint * link.adjoint() * w_adjoint;
+}
+
+Heatbath::Heatbath(int const length_space, int const length_time, int const seed)
+    : seed(seed) {
+    if (length_space % 2 != 0 || length_time % 2 != 0) {
+        throw std::invalid_argument(
+            "The checkerboard heatbath needs even lattice extents.");
+    }
+
+    Configuration const geometry(length_space, length_time);
+    for (int n1 = 0; n1 < length_time; ++n1) {
+        for (int n2 = 0; n2 < length_space; ++n2) {
+            for (int n3 = 0; n3 < length_space; ++n3) {
+                for (int n4 = 0; n4 < length_space; ++n4) {
+                    int const parity = (n1 + n2 + n3 + n4) % 2;
+                    sites[parity].push_back(geometry.get_site(n1, n2, n3, n4));
+                }
+            }
+        }
+    }
+}
+
+void Heatbath::heatbath_sweep(Configuration &links,
+                              double const beta,
+                              std::uint64_t const sweep) {
+    CounterRng const rng(seed, CounterRng::Purpose::heatbath, sweep);
+    for (int mu = 0; mu < 4; ++mu) {
+        for (int parity = 0; parity < 2; ++parity) {
+            std::vector<int> const &parity_sites = sites[parity];
+#pragma omp parallel for
+            for (size_t i = 0; i < parity_sites.size(); ++i) {
+                int const site = parity_sites[i];
+                Quaternion const staples = get_staples(site, mu, links);
+                LinkUniforms uniform(rng, 4 * static_cast<std::uint64_t>(site) + mu);
+                links(site, mu) = heatbath_link(staples, beta, uniform);
+            }
+        }
+    }
+}
+
+void Heatbath::overrelaxation_sweep(Configuration &links) {
+    for (int mu = 0; mu < 4; ++mu) {
+        for (int parity = 0; parity < 2; ++parity) {
+            std::vector<int> const &parity_sites = sites[parity];
+#pragma omp parallel for
+            for (size_t i = 0; i < parity_sites.size(); ++i) {
+                int const site = parity_sites[i];
+                Quaternion const staples = get_staples(site, mu, links);
+                links(site, mu) = overrelax_link(links(site, mu), staples);
+            }
+        }
+    }
+}
+
+void Heatbath::update(Configuration &links,
+                      double const beta,
+                      int const overrelaxation_steps,
+                      std::uint64_t const sweep) {
+    heatbath_sweep(links, beta, sweep);
+    for (int i = 0; i < overrelaxation_steps; ++i) {
+        overrelaxation_sweep(links);
+    }
+}
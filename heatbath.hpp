@@ -0,0 +1,93 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include "configuration.hpp"
+#include "counter-rng.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+  Uniform random numbers in (0, 1) for the update of a single link.
+
+  They are taken from the counter-based generator at indices that belong to the
+  link alone, so any number of them can be drawn without touching the numbers of
+  other links.
+  */
+class LinkUniforms {
+  public:
+    LinkUniforms(CounterRng const &rng, std::uint64_t const link)
+        : rng(rng), next_index(link << 32), position(4) {}
+
+    double operator()() {
+        if (position == 4) {
+            rng.uniforms(next_index++, buffer);
+            position = 0;
+        }
+        return buffer[position++];
+    }
+
+  private:
+    CounterRng const &rng;
+    std::uint64_t next_index;
+    int position;
+    double buffer[4];
+};
+
+/**
+  Kennedy–Pendleton heatbath for a single link.
+
+  The new link is drawn from the distribution \f$ \exp(\beta / N \operatorname{Re}
+  \operatorname{tr}(U V)) \f$ with the sum of staples \f$ V \f$, independent of the
+  old link.
+  */
+Quaternion heatbath_link(Quaternion const &staples,
+                         double const beta,
+                         LinkUniforms &uniform);
+
+/**
+  Microcanonical overrelaxation of a single link.
+
+  The link is reflected such that \f$ \operatorname{Re} \operatorname{tr}(U V) \f$
+  and therefore the action stays the same.
+  */
+Quaternion overrelax_link(Quaternion const &link, Quaternion const &staples);
+
+/**
+  Update engine with heatbath and overrelaxation sweeps.
+
+  The links of one direction on sites of the same parity do not appear in each
+  other's staples, so they are updated in parallel. This needs even lattice
+  extents. The random numbers are keyed by the seed, the sweep and the link, the
+  result does not depend on the number of threads and there is no state to save.
+  */
+class Heatbath {
+  public:
+    Heatbath(int const length_space, int const length_time, int const seed);
+
+    /**
+      \param sweep Number of the sweep, every sweep of the chain needs a different
+      one.
+      */
+    void heatbath_sweep(Configuration &links, double const beta, std::uint64_t const sweep);
+    void overrelaxation_sweep(Configuration &links);
+
+    /**
+      One heatbath sweep followed by the given number of overrelaxation sweeps.
+
+      \param sweep Number of the heatbath sweep, for instance the trajectory.
+      */
+    void update(Configuration &links,
+                double const beta,
+                int const overrelaxation_steps,
+                std::uint64_t const sweep);
+
+  private:
+    /// Site indices of the even and odd sites.
+    std::vector<int> sites[2];
+
+    std::uint32_t seed;
+};
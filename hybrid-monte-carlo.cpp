@@ -2,168 +2,288 @@
 
 #include "hybrid-monte-carlo.hpp"
 
+#include "integrator.hpp"
+#include "metrics.hpp"
+#include "parallel.hpp"
 #include "pauli-matrices.hpp"
 #include "sanity-checks.hpp"
 
-#include <unsupported/Eigen/MatrixFunctions>
-
 #include <cassert>
 #include <iostream>
 #include <random>
 
-double md_evolution(Configuration &links,
-                    std::mt19937 &engine,
-                    std::normal_distribution<double> &dist,
-                    double const time_step,
-                    int const md_steps,
-                    double const beta) {
-    Configuration momenta(links.length_space, links.length_time);
-    randomize_algebra(momenta, engine, dist);
+namespace {
+
+/**
+  Link update of `md_link_step` in the precision of the fields.
+  */
+template <typename Links, typename Momenta>
+void link_step(Links const &links,
+               Links &new_links,
+               Momenta const &momenta,
+               double const time_step) {
+    // Every new link only depends on the old link at the same place, so this works
+    // in place as well.
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int site = 0; site < links.get_volume(); ++site) {
+            for (int mu = 0; mu < 4; ++mu) {
+                new_links(site, mu) =
+                    compute_new_link(site, mu, links, momenta, time_step);
+            }
+        }
+    });
+}
+
+/**
+  Momentum update of `md_momentum_step` in the precision of the fields, the
+  plaquette trace sum is accumulated in double precision.
+  */
+template <typename Links, typename Momenta>
+double momentum_step(Links const &links,
+                     Momenta &momenta,
+                     double const time_step,
+                     double const beta) {
+    // The force only depends on the links, every momentum only on its old value.
+    double const links_staples_trace_sum = parallel_sum([&](double &partial) {
+#pragma omp for schedule(static)
+        for (int site = 0; site < links.get_volume(); ++site) {
+            for (int mu = 0; mu < 4; ++mu) {
+                typename Links::value_type const links_staples =
+                    links(site, mu) * get_staples(site, mu, links);
+                partial += links_staples.trace();
+                momenta(site, mu) +=
+                    time_step * get_momentum_derivative(links_staples, beta);
+            }
+        }
+    });
+    return links_staples_trace_sum / 4;
+}
+
+template <typename Links>
+inline typename Links::value_type
+sum_staples(int const site, int const mu, Links const &links) {
+    NeighborTable const &neighbors = links.get_neighbors();
+    int const site_mu = neighbors.forward(site, mu);
 
-    double const old_energy = get_energy(links, momenta, beta);
+    typename Links::value_type staples;
+    for (int nu = 0; nu < 4; ++nu) {
+        if (nu == mu) {
+            continue;
+        }
+
+        auto const &link1 = links(site_mu, nu);
+        auto const &link2 = links(neighbors.forward(site, nu), mu);
+        auto const &link3 = links(site, nu);
 
-    md_momentum_step(links, momenta, engine, dist, time_step / 2, beta);
-    md_link_step(links, momenta, engine, dist, time_step, beta);
-    for (int md_step_idx = 1; md_step_idx != md_steps; ++md_step_idx) {
-        md_momentum_step(links, momenta,engine, dist, time_step, beta);
-        md_link_step(links, momenta, engine, dist, time_step, beta);
+        staples += link1 * link2.adjoint() * link3.adjoint();
+
+        int const site_minus_nu = neighbors.backward(site, nu);
+        auto const &link4 = links(neighbors.diagonal(site, mu, nu), nu);
+        auto const &link5 = links(site_minus_nu, mu);
+        auto const &link6 = links(site_minus_nu, nu);
+
+        staples += link4.adjoint() * link5.adjoint() * link6;
     }
-    md_momentum_step(links, momenta, engine, dist, time_step / 2, beta);
+    return staples;
+}
 
-    double const new_energy = get_energy(links, momenta, beta);
-    double const energy_difference = new_energy - old_energy;
+template <typename Real>
+BasicAlgebra<Real> momentum_derivative(BasicQuaternion<Real> const &links_staples,
+                                       double const beta) {
+    // With U V = x_0 + i x·σ the anti-Hermitian part is U V - (U V)^\dagger = 2 i x·σ.
+    // The derivative i β / (2 N) (U V - (U V)^\dagger) is therefore just -β / N x·σ
+    // and automatically Hermitian and traceless.
+    Real const factor = -beta / static_cast<double>(number_of_colors);
+    return BasicAlgebra<Real>(
+        factor * links_staples[1], factor * links_staples[2], factor * links_staples[3]);
+}
 
-    std::cout << "HMD Energy: " << old_energy << " → " << new_energy
-              << "; ΔE = " << energy_difference << std::endl;
+template <typename Real>
+inline BasicQuaternion<Real> rotate_link(BasicQuaternion<Real> const &link,
+                                         BasicAlgebra<Real> const &momentum,
+                                         double const time_step) {
+    BasicQuaternion<Real> const exponent =
+        static_cast<Real>(time_step) * momentum.times_imag_unit();
+    return exp(exponent) * link;
+}
+}  // namespace
 
-    return energy_difference;
+double md_evolution(Configuration const &links,
+                    Configuration &proposal,
+                    MomentumConfiguration &momenta,
+                    Integrator const &integrator,
+                    double const time_step,
+                    int const md_steps,
+                    double const beta,
+                    Layout const layout,
+                    double const links_plaquette_trace_sum,
+                    double &proposal_plaquette_trace_sum,
+                    Precision const precision,
+                    int const reunitarize_every,
+                    PhaseTimers *const timers) {
+    MdState state(proposal, momenta, beta, layout, precision, reunitarize_every, timers);
+    return md_evolution(state, links, integrator, time_step, md_steps,
+                        links_plaquette_trace_sum, proposal_plaquette_trace_sum);
 }
 
-void md_link_step(Configuration &links,
-             Configuration &momenta,
-             std::mt19937 &engine,
-             std::normal_distribution<double> &dist,
-             double const time_step,
-             double const beta) {
-    auto const links_old = links;
-#pragma omp parallel for
-    for (int n1 = 0; n1 < links.length_time; ++n1) {
-        for (int n2 = 0; n2 < links.length_space; ++n2) {
-            for (int n3 = 0; n3 < links.length_space; ++n3) {
-                for (int n4 = 0; n4 < links.length_space; ++n4) {
-                    for (int mu = 0; mu < 4; ++mu) {
-                        links(n1, n2, n3, n4, mu) = compute_new_link(
-                            n1, n2, n3, n4, mu, links_old, momenta, time_step);
-                    }
-                }
-            }
+double md_evolution(MdState &state,
+                    Configuration const &links,
+                    Integrator const &integrator,
+                    double const time_step,
+                    int const md_steps,
+                    double const links_plaquette_trace_sum,
+                    double &proposal_plaquette_trace_sum) {
+    MomentumConfiguration const &momenta = state.get_momenta();
+    double const beta = state.get_beta();
+    PhaseTimers *const timers = state.get_timers();
+    state.start(links);
+    double old_momentum_energy = 0.0;
+    double new_momentum_energy = 0.0;
+
+    // One team of threads for the whole trajectory. All threads run through the
+    // integrator and share the sweeps, which end with a barrier each.
+#pragma omp parallel proc_bind(close)
+    {
+        double old_momentum_energy_local;
+        {
+            ScopedTimer const timer(timers, Phase::energy);
+            old_momentum_energy_local = get_momentum_energy(momenta, beta);
+        }
+        integrator.integrate(state, time_step, md_steps);
+        state.finish();
+        double plaquette_trace_sum_local, new_momentum_energy_local;
+        {
+            ScopedTimer const timer(timers, Phase::energy);
+            plaquette_trace_sum_local = state.get_plaquette_trace_sum();
+            new_momentum_energy_local = get_momentum_energy(momenta, beta);
+        }
+#pragma omp master
+        {
+            old_momentum_energy = old_momentum_energy_local;
+            new_momentum_energy = new_momentum_energy_local;
+            proposal_plaquette_trace_sum = plaquette_trace_sum_local;
         }
     }
+    assert(&state.get_links() != &links);
+
+    int const volume = links.get_volume();
+    double const old_energy =
+        get_link_energy(volume, links_plaquette_trace_sum, beta) + old_momentum_energy;
+    double const new_energy =
+        get_link_energy(volume, proposal_plaquette_trace_sum, beta) + new_momentum_energy;
+    return new_energy - old_energy;
+}
+
+void md_link_step(Configuration &links,
+                  MomentumConfiguration &momenta,
+                  std::mt19937 &engine,
+                  std::normal_distribution<double> &dist,
+                  double const time_step,
+                  double const beta) {
+    md_link_step(links, links, momenta, time_step);
+}
+
+void md_link_step(Configuration const &links,
+                  Configuration &new_links,
+                  MomentumConfiguration const &momenta,
+                  double const time_step) {
+    link_step(links, new_links, momenta, time_step);
+}
+
+void md_link_step(SingleConfiguration const &links,
+                  SingleConfiguration &new_links,
+                  SingleMomentumConfiguration const &momenta,
+                  double const time_step) {
+    link_step(links, new_links, momenta, time_step);
 }
 
 void md_momentum_step(Configuration &links,
-                      Configuration &momenta,
+                      MomentumConfiguration &momenta,
                       std::mt19937 &engine,
                       std::normal_distribution<double> &dist,
                       double const time_step,
                       double const beta) {
-    auto const momenta_old = momenta;
-#pragma omp parallel for
-    for (int n1 = 0; n1 < links.length_time; ++n1) {
-        for (int n2 = 0; n2 < links.length_space; ++n2) {
-            for (int n3 = 0; n3 < links.length_space; ++n3) {
-                for (int n4 = 0; n4 < links.length_space; ++n4) {
-                    for (int mu = 0; mu < 4; ++mu) {
-                        momenta(n1, n2, n3, n4, mu) = compute_new_momentum(
-                            n1, n2, n3, n4, mu, links, momenta_old, time_step, beta);
-                    }
-                }
-            }
-        }
-    }
+    md_momentum_step(links, momenta, time_step, beta);
 }
 
-Matrix compute_new_momentum(int const n1,
-                                      int const n2,
-                                      int const n3,
-                                      int const n4,
-                                      int const mu,
-                                      Configuration const &links,
-                                      Configuration const &momenta,
-                                      double const time_step,
-                                      double const beta) {
-    // Copy old momentum.
-    Matrix result = momenta(n1, n2, n3, n4, mu);
-    assert(is_traceless(result));
-    assert(is_hermitian(result));
-    result += time_step * compute_momentum_derivative(n1, n2, n3, n4, mu, links, beta);
-    assert(is_traceless(result));
-    assert(is_hermitian(result));
-    return result;
+double md_momentum_step(Configuration const &links,
+                        MomentumConfiguration &momenta,
+                        double const time_step,
+                        double const beta) {
+    return momentum_step(links, momenta, time_step, beta);
 }
 
-Matrix get_staples(int const n1,
+double md_momentum_step(SingleConfiguration const &links,
+                        SingleMomentumConfiguration &momenta,
+                        double const time_step,
+                        double const beta) {
+    return momentum_step(links, momenta, time_step, beta);
+}
+
+Algebra compute_new_momentum(int const n1,
                              int const n2,
                              int const n3,
                              int const n4,
                              int const mu,
-                             Configuration const &links) {
-    Matrix staples;
-    // XXX Perhaps use std::array here.
-    std::vector<int> const old_coords{n1, n2, n3, n4};
-    for (int nu = 0; nu < 4; ++nu) {
-        if (nu == mu) {
-            continue;
-        }
-        auto coords = old_coords;
+                             Configuration const &links,
+                             MomentumConfiguration const &momenta,
+                             double const time_step,
+                             double const beta) {
+    return compute_new_momentum(
+        links.get_site(n1, n2, n3, n4), mu, links, momenta, time_step, beta);
+}
 
-        Matrix const &link3 = links(coords, nu);
-        ++coords[mu];
-        Matrix const &link1 = links(coords, nu);
-        --coords[mu];
-        ++coords[nu];
-        Matrix const &link2 = links(coords, mu);
+Algebra compute_new_momentum(int const site,
+                             int const mu,
+                             Configuration const &links,
+                             MomentumConfiguration const &momenta,
+                             double const time_step,
+                             double const beta) {
+    // Copy old momentum.
+    Algebra result = momenta(site, mu);
+    result += time_step * compute_momentum_derivative(site, mu, links, beta);
+    return result;
+}
 
-        staples += link1 * link2.adjoint() * link3.adjoint();
+Quaternion get_staples(int const n1,
+                       int const n2,
+                       int const n3,
+                       int const n4,
+                       int const mu,
+                       Configuration const &links) {
+    return get_staples(links.get_site(n1, n2, n3, n4), mu, links);
+}
 
-        coords = old_coords;
+Quaternion get_staples(int const site, int const mu, Configuration const &links) {
+    return sum_staples(site, mu, links);
+}
 
-        --coords[nu];
-        Matrix const &link6 = links(coords, nu);
-        Matrix const &link5 = links(coords, mu);
-        ++coords[mu];
-        Matrix const &link4 = links(coords, nu);
+SingleQuaternion
+get_staples(int const site, int const mu, SingleConfiguration const &links) {
+    return sum_staples(site, mu, links);
+}
 
-        staples += link4.adjoint() * link5.adjoint() * link6;
-    }
-    return staples;
+Algebra compute_momentum_derivative(int const n1,
+                                    int const n2,
+                                    int const n3,
+                                    int const n4,
+                                    int const mu,
+                                    Configuration const &links,
+                                    double const beta) {
+    return compute_momentum_derivative(links.get_site(n1, n2, n3, n4), mu, links, beta);
 }
 
-Matrix compute_momentum_derivative(int const n1,
-                                             int const n2,
-                                             int const n3,
-                                             int const n4,
-                                             int const mu,
-                                             Configuration const &links,
-                                             double const beta) {
-    Matrix staples = get_staples(n1, n2, n3, n4, mu, links);
-    Matrix const links_staples = links(n1, n2, n3, n4, mu) * staples;
-    Matrix const minus_adjoint = links_staples - links_staples.adjoint().eval();
-    Matrix const derivative =
-        imag_unit * beta / static_cast<double>(number_of_colors) * minus_adjoint;
-
-#ifndef NDEBUG
-    if (!is_traceless(derivative)) {
-        std::cerr << "Momentum is not traceless!\n";
-        std::cerr << n1 << ", " << n2 << ", " << n3 << ", " << n4 << "; " << mu << "\n";
-        std::cerr << "UV:\n";
-        std::cerr << links_staples << "\n";
-        std::cerr << "UV - (UV)^\\dagger:\n";
-        std::cerr << minus_adjoint << "\n";
-        std::cerr << "\\dot H:\n";
-        std::cerr << derivative << std::endl;
-    }
-#endif
+Algebra compute_momentum_derivative(int const site,
+                                    int const mu,
+                                    Configuration const &links,
+                                    double const beta) {
+    Quaternion const staples = get_staples(site, mu, links);
+    return get_momentum_derivative(links(site, mu) * staples, beta);
+}
+
+Algebra get_momentum_derivative(Quaternion const &links_staples, double const beta) {
+    Algebra const derivative = momentum_derivative(links_staples, beta);
 
     assert(is_traceless(derivative));
     assert(is_hermitian(derivative));
@@ -171,117 +291,137 @@ Matrix compute_momentum_derivative(int const n1,
     return derivative;
 }
 
-Matrix compute_new_link(int const n1,
-                        int const n2,
-                        int const n3,
-                        int const n4,
-                        int const mu,
-                        Configuration const &links,
-                        Configuration const &momenta_half,
-                        double const time_step) {
-    Matrix const exponent = imag_unit * time_step * momenta_half(n1, n2, n3, n4, mu);
-    Matrix const rotation = exponent.exp();
-    assert(is_unitary(rotation));
+SingleAlgebra get_momentum_derivative(SingleQuaternion const &links_staples,
+                                      double const beta) {
+    return momentum_derivative(links_staples, beta);
+}
+
+Quaternion compute_new_link(int const n1,
+                            int const n2,
+                            int const n3,
+                            int const n4,
+                            int const mu,
+                            Configuration const &links,
+                            MomentumConfiguration const &momenta_half,
+                            double const time_step) {
+    return compute_new_link(
+        links.get_site(n1, n2, n3, n4), mu, links, momenta_half, time_step);
+}
 
-    Matrix const new_link = rotation * links(n1, n2, n3, n4, mu);
+Quaternion compute_new_link(int const site,
+                            int const mu,
+                            Configuration const &links,
+                            MomentumConfiguration const &momenta_half,
+                            double const time_step) {
+    Quaternion const new_link =
+        rotate_link(links(site, mu), momenta_half(site, mu), time_step);
     assert(is_unitary(new_link));
 
     return new_link;
 }
 
-Matrix get_plaquette(int const n1,
-                     int const n2,
-                     int const n3,
-                     int const n4,
-                     int const mu,
-                     int const nu,
-                     Configuration const &links,
-                     bool const debug) {
-    std::vector<int> coords{n1, n2, n3, n4};
-
-    Matrix const &link1 = links(coords, mu);
-    Matrix const &link4 = links(coords, nu);
-    ++coords[mu];
-    Matrix const &link2 = links(coords, nu);
-    --coords[mu];
-    ++coords[nu];
-    Matrix const &link3 = links(coords, mu);
+SingleQuaternion compute_new_link(int const site,
+                                  int const mu,
+                                  SingleConfiguration const &links,
+                                  SingleMomentumConfiguration const &momenta_half,
+                                  double const time_step) {
+    return rotate_link(links(site, mu), momenta_half(site, mu), time_step);
+}
+
+Quaternion get_plaquette(int const n1,
+                         int const n2,
+                         int const n3,
+                         int const n4,
+                         int const mu,
+                         int const nu,
+                         Configuration const &links,
+                         bool const debug) {
+    int const site = links.get_site(n1, n2, n3, n4);
 
     if (debug) {
-        std::cout << "link1:\n" << link1 << "\n";
-        std::cout << "link2:\n" << link2 << "\n";
-        std::cout << "link3:\n" << link3 << "\n";
-        std::cout << "link4:\n" << link4 << "\n";
+        NeighborTable const &neighbors = links.get_neighbors();
+        std::cout << "link1:\n" << links(site, mu) << "\n";
+        std::cout << "link2:\n" << links(neighbors.forward(site, mu), nu) << "\n";
+        std::cout << "link3:\n" << links(neighbors.forward(site, nu), mu) << "\n";
+        std::cout << "link4:\n" << links(site, nu) << "\n";
     }
 
-    Matrix const plaquette = link1 * link2 * link3.adjoint() * link4.adjoint();
+    return get_plaquette(site, mu, nu, links);
+}
+
+Quaternion
+get_plaquette(int const site, int const mu, int const nu, Configuration const &links) {
+    NeighborTable const &neighbors = links.get_neighbors();
+
+    Quaternion const &link1 = links(site, mu);
+    Quaternion const &link2 = links(neighbors.forward(site, mu), nu);
+    Quaternion const &link3 = links(neighbors.forward(site, nu), mu);
+    Quaternion const &link4 = links(site, nu);
+
+    Quaternion const plaquette = link1 * link2 * link3.adjoint() * link4.adjoint();
     assert(is_unitary(plaquette));
     return plaquette;
 }
 
 std::complex<double> get_plaquette_trace_sum(Configuration const &links) {
-    double real = 0.0;
-    double imag = 0.0;
-
-#pragma omp parallel for reduction(+ : real, imag)
-    for (int n1 = 0; n1 < links.length_time; ++n1) {
-        for (int n2 = 0; n2 < links.length_space; ++n2) {
-            for (int n3 = 0; n3 < links.length_space; ++n3) {
-                for (int n4 = 0; n4 < links.length_space; ++n4) {
-                    for (int mu = 0; mu < 4; ++mu) {
-                        for (int nu = 0; nu < mu; ++nu) {
-                            Matrix const plaquette =
-                                get_plaquette(n1, n2, n3, n4, mu, nu, links);
-                            auto const summand = plaquette.trace();
-                            assert(std::isfinite(summand.real()));
-                            assert(std::isfinite(summand.imag()));
-                            real += summand.real();
-                            imag += summand.imag();
-                        }
-                    }
+    double const real = parallel_sum([&](double &partial) {
+#pragma omp for schedule(static)
+        for (int site = 0; site < links.get_volume(); ++site) {
+            for (int mu = 0; mu < 4; ++mu) {
+                for (int nu = 0; nu < mu; ++nu) {
+                    Quaternion const plaquette = get_plaquette(site, mu, nu, links);
+                    // The trace of a quaternion is always real.
+                    double const summand = plaquette.trace();
+                    assert(std::isfinite(summand));
+                    partial += summand;
                 }
             }
         }
-    }
+    });
 
-    return std::complex<double>{real, imag};
+    return std::complex<double>{real, 0.0};
 }
 
 std::complex<double> get_plaquette_trace_average(Configuration const &links) {
-    double const summands = links.get_volume() * (3 + 2 + 1) * number_of_colors;
-    return get_plaquette_trace_sum(links) / summands;
+    return get_plaquette_trace_average(links.get_volume(),
+                                       get_plaquette_trace_sum(links).real());
+}
+
+std::complex<double> get_plaquette_trace_average(int const volume,
+                                                 double const plaquette_trace_sum) {
+    double const summands = volume * (3 + 2 + 1) * number_of_colors;
+    return std::complex<double>{plaquette_trace_sum / summands, 0.0};
 }
 
 double get_link_energy(Configuration const &links, double const beta) {
+    return get_link_energy(
+        links.get_volume(), get_plaquette_trace_sum(links).real(), beta);
+}
+
+double get_link_energy(int const volume,
+                       double const plaquette_trace_sum,
+                       double const beta) {
+    // Wilson action β / N Σ Re tr(1 - U_p).
     double links_part = 0.0;
-    links_part += links.get_volume() * (3 + 2 + 1);
-    links_part -= get_plaquette_trace_sum(links).real();
-    return links_part * beta;
-}
-
-double get_momentum_energy(Configuration const &momenta, double const beta) {
-    double momentum_part = 0.0;
-#pragma omp parallel for reduction(+ : momentum_part)
-    for (int n1 = 0; n1 < momenta.length_time; ++n1) {
-        for (int n2 = 0; n2 < momenta.length_space; ++n2) {
-            for (int n3 = 0; n3 < momenta.length_space; ++n3) {
-                for (int n4 = 0; n4 < momenta.length_space; ++n4) {
-                    for (int mu = 0; mu < 4; ++mu) {
-                        Matrix const &momentum = momenta(n1, n2, n3, n4, mu);
-                        auto const trace = (momentum * momentum).trace();
-                        assert(is_real(trace));
-                        auto const summand = trace.real();
-                        assert(std::isfinite(summand));
-                        momentum_part += summand;
-                    }
-                }
-            }
+    links_part += volume * (3 + 2 + 1) * number_of_colors;
+    links_part -= plaquette_trace_sum;
+    return links_part * beta / number_of_colors;
+}
+
+double get_momentum_energy(MomentumConfiguration const &momenta, double const beta) {
+    // With P = p·σ one has tr(P^2) / 2 = p·p, a plain sum of squares.
+    return parallel_sum([&](double &partial) {
+#pragma omp for schedule(static)
+        for (int i = 0; i < momenta.get_size(); ++i) {
+            double const summand = momenta[i].norm_squared();
+            assert(std::isfinite(summand));
+            partial += summand;
         }
-    }
-     return 0.5 * momentum_part;
+    });
 }
 
-double
-get_energy(Configuration const &links, Configuration const &momenta, double const beta) {
+double get_energy(Configuration const &links,
+                  MomentumConfiguration const &momenta,
+                  double const beta) {
     return get_link_energy(links, beta) + get_momentum_energy(momenta, beta);
 }
@@ -9,86 +9,258 @@
 
 #include <random>
 
-double md_evolution(Configuration &links,
-                    std::mt19937 &engine,
-                    std::normal_distribution<double> &dist,
+class Integrator;
+class MdState;
+class PhaseTimers;
+
+/**
+  Memory layout of the links used for the force computation.
+  */
+enum class Layout {
+    /// Scalar reference path working on `Configuration` directly.
+    array_of_structures,
+    /// SIMD kernel working on a `SoaConfiguration` copy of the links.
+    structure_of_arrays,
+    /// Scalar path that forms every plaquette once and scatters it to its links.
+    plaquette
+};
+
+/**
+  Floating point precision of the molecular dynamics.
+  */
+enum class Precision {
+    /// Everything in double precision.
+    full,
+    /// Links, momenta and forces in single precision during the trajectory, which
+    /// halves the bytes per link. The Hamiltonian for the accept/reject step is
+    /// evaluated in double precision at both ends. Only with
+    /// `Layout::array_of_structures`.
+    mixed
+};
+
+/**
+  Integrates one molecular dynamics trajectory.
+
+  The links are not changed, the evolved links are written into `proposal`. The
+  caller can then swap the two on acceptance instead of keeping a backup copy.
+
+  The momenta have to be drawn by the caller with variance 1/2, they are evolved
+  in place. The plaquette trace sum of the links is passed in, usually cached from
+  the previous trajectory. The one of the proposal is taken from the last force
+  evaluation, such that no extra sweep over the plaquettes is needed. With
+  `Precision::mixed` it is computed from the proposal in double precision instead.
+
+  \param reunitarize_every With `Precision::mixed` the single precision links are
+  projected back onto SU(2) after every this many link updates and at the end.
+  \param timers If not null, the force and link updates and the energies are timed.
+
+  \returns Energy difference between the end and the start of the trajectory.
+  */
+double md_evolution(Configuration const &links,
+                    Configuration &proposal,
+                    MomentumConfiguration &momenta,
+                    Integrator const &integrator,
                     double const time_step,
                     int const md_steps,
-                    double const beta);
+                    double const beta,
+                    Layout const layout,
+                    double const links_plaquette_trace_sum,
+                    double &proposal_plaquette_trace_sum,
+                    Precision const precision = Precision::full,
+                    int const reunitarize_every = 10,
+                    PhaseTimers *const timers = nullptr);
+
+/**
+  Integrates one molecular dynamics trajectory like the above, with a state that
+  is reused across trajectories.
+
+  The state brings the proposal, the momenta, β, the layout and the precision. Its
+  fields are not allocated again for every trajectory.
+  */
+double md_evolution(MdState &state,
+                    Configuration const &links,
+                    Integrator const &integrator,
+                    double const time_step,
+                    int const md_steps,
+                    double const links_plaquette_trace_sum,
+                    double &proposal_plaquette_trace_sum);
 
 void md_momentum_half_step(Configuration &links,
-                           Configuration &momenta,
+                           MomentumConfiguration &momenta,
                            std::mt19937 &engine,
                            std::normal_distribution<double> &dist,
                            double const time_step,
                            double const beta);
 
 void md_link_step(Configuration &links,
-                  Configuration &momenta,
+                  MomentumConfiguration &momenta,
                   std::mt19937 &engine,
                   std::normal_distribution<double> &dist,
                   double const time_step,
                   double const beta);
 
+/**
+  Updates the links with the momenta.
+
+  `new_links` may be the same object as `links`, then the update is in place.
+  */
+void md_link_step(Configuration const &links,
+                  Configuration &new_links,
+                  MomentumConfiguration const &momenta,
+                  double const time_step);
+
+/**
+  Updates the links with the momenta in single precision.
+  */
+void md_link_step(SingleConfiguration const &links,
+                  SingleConfiguration &new_links,
+                  SingleMomentumConfiguration const &momenta,
+                  double const time_step);
+
 void md_momentum_step(Configuration &links,
-                      Configuration &momenta,
+                      MomentumConfiguration &momenta,
                       std::mt19937 &engine,
                       std::normal_distribution<double> &dist,
                       double const time_step,
                       double const beta);
 
+/**
+  Updates the momenta in place with the force from the links.
+
+  Every plaquette occurs in the staples of its four links, so a quarter of the
+  sum of Re tr(U V) over all links is the plaquette trace sum. It comes for free
+  with the force.
+
+  \returns Plaquette trace sum of the links.
+  */
+double md_momentum_step(Configuration const &links,
+                      MomentumConfiguration &momenta,
+                      double const time_step,
+                      double const beta);
+
+/**
+  Updates the momenta in place with the force in single precision.
+
+  \returns Plaquette trace sum of the links, summed in double precision.
+  */
+double md_momentum_step(SingleConfiguration const &links,
+                        SingleMomentumConfiguration &momenta,
+                        double const time_step,
+                        double const beta);
+
 /**
   Compute the new momentum half a timestep further.
   */
-Matrix compute_new_momentum(int const n1,
+Algebra compute_new_momentum(int const n1,
+                             int const n2,
+                             int const n3,
+                             int const n4,
+                             int const mu,
+                             Configuration const &links,
+                             MomentumConfiguration const &momenta,
+                             double const time_step,
+                             double const beta);
+
+Algebra compute_new_momentum(int const site,
+                             int const mu,
+                             Configuration const &links,
+                             MomentumConfiguration const &momenta,
+                             double const time_step,
+                             double const beta);
+
+/**
+  Compute the staples for a given link.
+  */
+Quaternion get_staples(int const n1,
+                       int const n2,
+                       int const n3,
+                       int const n4,
+                       int const mu,
+                       Configuration const &links);
+
+/**
+  Compute the staples for a given link, addressed by site index.
+
+  The neighbors are taken from the precomputed table, so this does neither
+  allocate nor need integer divisions for the periodic boundary conditions.
+  */
+Quaternion get_staples(int const site, int const mu, Configuration const &links);
+
+SingleQuaternion
+get_staples(int const site, int const mu, SingleConfiguration const &links);
+
+Algebra compute_momentum_derivative(int const n1,
+                                    int const n2,
+                                    int const n3,
+                                    int const n4,
+                                    int const mu,
+                                    Configuration const &links,
+                                    double const beta);
+
+Algebra compute_momentum_derivative(int const site,
+                                    int const mu,
+                                    Configuration const &links,
+                                    double const beta);
+
+/**
+  Momentum derivative of a link from the product of the link and its staples.
+  */
+Algebra get_momentum_derivative(Quaternion const &links_staples, double const beta);
+
+SingleAlgebra get_momentum_derivative(SingleQuaternion const &links_staples,
+                                      double const beta);
+
+Quaternion compute_new_link(int const n1,
                             int const n2,
                             int const n3,
                             int const n4,
                             int const mu,
                             Configuration const &links,
-                            Configuration const &momenta,
-                            double const time_step,
-                            double const beta);
+                            MomentumConfiguration const &momenta_half,
+                            double const time_step);
 
-/**
-  Compute the staples for a given link.
-  */
-Matrix get_staples(int const n1,
-                   int const n2,
-                   int const n3,
-                   int const n4,
-                   int const mu,
-                   Configuration const &links);
-
-Matrix compute_momentum_derivative(int const n1,
-                                   int const n2,
-                                   int const n3,
-                                   int const n4,
-                                   int const mu,
-                                   Configuration const &links,
-                                   double const beta);
-
-Matrix compute_new_link(int const n1,
-                        int const n2,
-                        int const n3,
-                        int const n4,
-                        int const mu,
-                        Configuration const &links,
-                        Configuration const &momenta_half,
-                        double const time_step);
-
-Matrix get_plaquette(int const n1,
-                     int const n2,
-                     int const n3,
-                     int const n4,
-                     int const mu,
-                     int const nu,
-                     Configuration const &links,
-                     bool const debug = false);
+Quaternion compute_new_link(int const site,
+                            int const mu,
+                            Configuration const &links,
+                            MomentumConfiguration const &momenta_half,
+                            double const time_step);
+
+SingleQuaternion compute_new_link(int const site,
+                                  int const mu,
+                                  SingleConfiguration const &links,
+                                  SingleMomentumConfiguration const &momenta_half,
+                                  double const time_step);
+
+Quaternion get_plaquette(int const n1,
+                         int const n2,
+                         int const n3,
+                         int const n4,
+                         int const mu,
+                         int const nu,
+                         Configuration const &links,
+                         bool const debug = false);
+
+Quaternion
+get_plaquette(int const site, int const mu, int const nu, Configuration const &links);
 
 std::complex<double> get_plaquette_trace_sum(Configuration const &links);
 std::complex<double> get_plaquette_trace_average(Configuration const &links);
 
-double get_energy(Configuration const &links, Configuration const &momenta, double const beta);
+/**
+  Normalized plaquette from a plaquette trace sum that is already known.
+  */
+std::complex<double> get_plaquette_trace_average(int const volume,
+                                                 double const plaquette_trace_sum);
+
+double get_energy(Configuration const &links,
+                  MomentumConfiguration const &momenta,
+                  double const beta);
 double get_link_energy(Configuration const &links, double const beta);
-double get_momentum_energy(Configuration const &momenta, double const beta);
+
+/**
+  Gauge action from a plaquette trace sum that is already known.
+  */
+double get_link_energy(int const volume,
+                       double const plaquette_trace_sum,
+                       double const beta);
+double get_momentum_energy(MomentumConfiguration const &momenta, double const beta);
@@ -0,0 +1,357 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "integrator.hpp"
+
+#include "metrics.hpp"
+#include "parallel.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+MdState::MdState(Configuration &proposal,
+                 MomentumConfiguration &momenta,
+                 double const beta,
+                 Layout const layout,
+                 Precision const precision,
+                 int const reunitarize_every,
+                 PhaseTimers *const timers)
+    : current(&proposal),
+      proposal(proposal),
+      momenta(momenta),
+      beta(beta),
+      timers(timers),
+      plaquette_trace_sum(0.0),
+      plaquette_trace_sum_valid(false),
+      soa_current(nullptr),
+      single_current(nullptr),
+      reunitarize_every(reunitarize_every),
+      link_steps(0) {
+    int const length_space = proposal.length_space;
+    int const length_time = proposal.length_time;
+    if (precision == Precision::mixed) {
+        if (layout != Layout::array_of_structures) {
+            throw std::invalid_argument(
+                "Mixed precision is only implemented for the aos layout.");
+        }
+        single_links.reset(new SingleConfiguration(length_space, length_time));
+        single_proposal.reset(new SingleConfiguration(length_space, length_time));
+        single_momenta.reset(new SingleMomentumConfiguration(length_space, length_time));
+    }
+
+    // The SIMD kernel works on a copy of the links in its own layout. The link
+    // updates stay in that layout until the end of the trajectory.
+    if (layout == Layout::structure_of_arrays) {
+        soa_links.reset(new SoaConfiguration(length_space, length_time));
+    } else if (layout == Layout::plaquette) {
+        links_staples.reset(new Configuration(length_space, length_time));
+    }
+}
+
+MdState::MdState(Configuration const &links,
+                 Configuration &proposal,
+                 MomentumConfiguration &momenta,
+                 double const beta,
+                 Layout const layout,
+                 Precision const precision,
+                 int const reunitarize_every,
+                 PhaseTimers *const timers)
+    : MdState(proposal, momenta, beta, layout, precision, reunitarize_every, timers) {
+    start(links);
+}
+
+void MdState::start(Configuration const &links) {
+    current = &links;
+    plaquette_trace_sum_valid = false;
+    link_steps = 0;
+    if (single_links) {
+        convert(links, *single_links);
+        convert(momenta, *single_momenta);
+        single_current = single_links.get();
+    }
+    if (soa_links) {
+        soa_links->assign(links);
+        soa_current = soa_links.get();
+    }
+}
+
+void MdState::momentum_step(double const step) {
+    ScopedTimer const timer(timers, Phase::force);
+    if (single_current) {
+        // The plaquette of single precision links is not used for the Hamiltonian.
+        momentum_step(*single_current, *single_momenta, step);
+        return;
+    }
+
+    double const sum = soa_current ? momentum_step(*soa_current, momenta, step)
+                                   : momentum_step(*current, momenta, step);
+#pragma omp single
+    {
+        plaquette_trace_sum = sum;
+        plaquette_trace_sum_valid = true;
+    }
+}
+
+double MdState::momentum_step(Configuration const &links,
+                              MomentumConfiguration &target,
+                              double const step) {
+    if (links_staples) {
+        return md_momentum_step(links, *links_staples, target, step, beta);
+    } else {
+        return md_momentum_step(links, target, step, beta);
+    }
+}
+
+double MdState::momentum_step(SingleConfiguration const &links,
+                              SingleMomentumConfiguration &target,
+                              double const step) {
+    return md_momentum_step(links, target, step, beta);
+}
+
+double MdState::momentum_step(SoaConfiguration const &links,
+                              MomentumConfiguration &target,
+                              double const step) {
+    return md_momentum_step(links, target, step, beta);
+}
+
+void MdState::link_step(double const step) {
+    ScopedTimer const timer(timers, Phase::link);
+    if (single_current) {
+        md_link_step(*single_current, *single_proposal, *single_momenta, step);
+#pragma omp single
+        {
+            single_current = single_proposal.get();
+            ++link_steps;
+        }
+        if (reunitarize_every > 0 && link_steps % reunitarize_every == 0) {
+            reunitarize(*single_proposal);
+        }
+        return;
+    }
+
+    if (soa_current) {
+        md_link_step(*soa_current, *soa_current, momenta, step);
+#pragma omp single
+        plaquette_trace_sum_valid = false;
+        return;
+    }
+
+    md_link_step(*current, proposal, momenta, step);
+#pragma omp single
+    {
+        current = &proposal;
+        plaquette_trace_sum_valid = false;
+    }
+}
+
+void MdState::force_gradient_step(double const step, double const shift) {
+    ScopedTimer const timer(timers, Phase::force);
+    int const length_space = proposal.length_space;
+    int const length_time = proposal.length_time;
+
+    if (single_current) {
+#pragma omp single
+        if (!single_forces) {
+            single_forces.reset(
+                new SingleMomentumConfiguration(length_space, length_time));
+            single_shifted_links.reset(
+                new SingleConfiguration(length_space, length_time));
+        }
+        force_gradient_step(*single_current, *single_momenta, *single_forces,
+                            *single_shifted_links, step, shift);
+        return;
+    }
+
+#pragma omp single
+    if (!forces) {
+        forces.reset(new MomentumConfiguration(length_space, length_time));
+        if (soa_links) {
+            soa_shifted_links.reset(new SoaConfiguration(length_space, length_time));
+        } else {
+            shifted_links.reset(new Configuration(length_space, length_time));
+        }
+    }
+    if (soa_current) {
+        force_gradient_step(
+            *soa_current, momenta, *forces, *soa_shifted_links, step, shift);
+    } else {
+        force_gradient_step(*current, momenta, *forces, *shifted_links, step, shift);
+    }
+}
+
+template <typename Links, typename Momenta>
+void MdState::force_gradient_step(Links const &links,
+                                  Momenta &momenta,
+                                  Momenta &forces,
+                                  Links &shifted_links,
+                                  double const step,
+                                  double const shift) {
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int i = 0; i < forces.get_size(); ++i) {
+            forces[i] = typename Momenta::value_type();
+        }
+    });
+    double const sum = momentum_step(links, forces, 1.0);
+    if (!single_current) {
+#pragma omp single
+        {
+            plaquette_trace_sum = sum;
+            plaquette_trace_sum_valid = true;
+        }
+    }
+    md_link_step(links, shifted_links, forces, shift);
+    momentum_step(shifted_links, momenta, step);
+}
+
+void MdState::finish() {
+    if (soa_current) {
+        ScopedTimer const timer(timers, Phase::link);
+        soa_current->extract(proposal);
+#pragma omp single
+        {
+            current = &proposal;
+            soa_current = nullptr;
+        }
+        return;
+    }
+    if (!single_current) {
+        return;
+    }
+
+    ScopedTimer const timer(timers, Phase::link);
+    // The single precision links are unitary only up to their rounding, they are
+    // projected before the Hamiltonian is evaluated in double precision.
+    convert(*single_current, proposal);
+    reunitarize(proposal);
+    convert(*single_momenta, momenta);
+#pragma omp single
+    {
+        current = &proposal;
+        single_current = nullptr;
+        plaquette_trace_sum_valid = false;
+    }
+}
+
+double MdState::get_plaquette_trace_sum() {
+    if (!plaquette_trace_sum_valid) {
+        // The links of the structure-of-arrays layout are copied out first.
+        if (soa_current) {
+            soa_current->extract(proposal);
+        }
+        double const sum =
+            ::get_plaquette_trace_sum(soa_current ? proposal : *current).real();
+#pragma omp single
+        {
+            plaquette_trace_sum = sum;
+            plaquette_trace_sum_valid = true;
+        }
+    }
+    return plaquette_trace_sum;
+}
+
+SplittingIntegrator::SplittingIntegrator(std::vector<Update> const &updates)
+    : updates(updates) {
+    assert(updates.size() >= 2);
+    assert(updates.front().kind == Update::Kind::momentum);
+    assert(updates.back().kind == Update::Kind::momentum);
+    assert(updates.front().coefficient == updates.back().coefficient);
+}
+
+void SplittingIntegrator::integrate(MdState &state,
+                                    double const time_step,
+                                    int const md_steps) const {
+    Update merged = updates.front();
+    merged.coefficient *= 2;
+
+    apply(state, updates.front(), time_step);
+    for (int md_step_idx = 0; md_step_idx != md_steps; ++md_step_idx) {
+        for (size_t i = 1; i + 1 < updates.size(); ++i) {
+            apply(state, updates[i], time_step);
+        }
+        // The last momentum update of this step and the first one of the next step
+        // are done at once.
+        apply(state, md_step_idx + 1 == md_steps ? updates.back() : merged, time_step);
+    }
+}
+
+int SplittingIntegrator::get_force_evaluations() const {
+    int evaluations = 0;
+    for (size_t i = 1; i < updates.size(); ++i) {
+        if (updates[i].kind == Update::Kind::momentum) {
+            evaluations += 1;
+        } else if (updates[i].kind == Update::Kind::force_gradient) {
+            evaluations += 2;
+        }
+    }
+    return evaluations;
+}
+
+void SplittingIntegrator::apply(MdState &state,
+                                Update const &update,
+                                double const time_step) const {
+    switch (update.kind) {
+        case Update::Kind::momentum:
+            state.momentum_step(update.coefficient * time_step);
+            break;
+        case Update::Kind::link:
+            state.link_step(update.coefficient * time_step);
+            break;
+        case Update::Kind::force_gradient:
+            state.force_gradient_step(update.coefficient * time_step,
+                                      update.shift * time_step * time_step);
+            break;
+    }
+}
+
+std::unique_ptr<Integrator> make_integrator(std::string const &name) {
+    using Kind = SplittingIntegrator::Update::Kind;
+
+    std::vector<SplittingIntegrator::Update> updates;
+    if (name == "leapfrog") {
+        updates = {{Kind::momentum, 0.5, 0.0},
+                   {Kind::link, 1.0, 0.0},
+                   {Kind::momentum, 0.5, 0.0}};
+    } else if (name == "omelyan") {
+        // Omelyan, Mryglod, Folk, Comput. Phys. Commun. 146 (2002) 188, the second
+        // order scheme with minimal error norm.
+        double const lambda = 0.1931833275037836;
+        updates = {{Kind::momentum, lambda, 0.0},
+                   {Kind::link, 0.5, 0.0},
+                   {Kind::momentum, 1 - 2 * lambda, 0.0},
+                   {Kind::link, 0.5, 0.0},
+                   {Kind::momentum, lambda, 0.0}};
+    } else if (name == "omf4") {
+        // Omelyan, Mryglod, Folk, Comput. Phys. Commun. 151 (2003) 272, the fourth
+        // order scheme with five force evaluations.
+        double const vartheta = 0.08398315262876693;
+        double const rho = 0.2539785108410595;
+        double const theta = -0.03230286765269967;
+        double const lambda = 0.6822365335719091;
+        double const middle_momentum = 0.5 - lambda - vartheta;
+        double const middle_link = 1 - 2 * (theta + rho);
+        updates = {{Kind::momentum, vartheta, 0.0},
+                   {Kind::link, rho, 0.0},
+                   {Kind::momentum, lambda, 0.0},
+                   {Kind::link, theta, 0.0},
+                   {Kind::momentum, middle_momentum, 0.0},
+                   {Kind::link, middle_link, 0.0},
+                   {Kind::momentum, middle_momentum, 0.0},
+                   {Kind::link, theta, 0.0},
+                   {Kind::momentum, lambda, 0.0},
+                   {Kind::link, rho, 0.0},
+                   {Kind::momentum, vartheta, 0.0}};
+    } else if (name == "force-gradient") {
+        // Omelyan, Mryglod, Folk, Comput. Phys. Commun. 151 (2003) 272, the fourth
+        // order force gradient scheme. The gradient term -ε³/72 [B, [A, B]] is
+        // realized with a link shift of ε²/24 in the central momentum update.
+        updates = {{Kind::momentum, 1.0 / 6.0, 0.0},
+                   {Kind::link, 0.5, 0.0},
+                   {Kind::force_gradient, 2.0 / 3.0, 1.0 / 24.0},
+                   {Kind::link, 0.5, 0.0},
+                   {Kind::momentum, 1.0 / 6.0, 0.0}};
+    } else {
+        throw std::invalid_argument("Unknown integrator “" + name + "”.");
+    }
+
+    return std::unique_ptr<Integrator>(new SplittingIntegrator(updates));
+}
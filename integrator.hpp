@@ -0,0 +1,248 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include "configuration.hpp"
+#include "hybrid-monte-carlo.hpp"
+#include "plaquette-force.hpp"
+#include "soa-configuration.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+  State of molecular dynamics trajectories and the elementary updates on it.
+
+  The links at the start of a trajectory are only read. The first link update
+  writes into the proposal, all later updates are in place on the proposal.
+
+  With `Precision::mixed` the links and momenta are copied into single precision
+  fields by `start` and all updates work on those. `finish` copies them back into
+  the proposal and the momenta. Likewise with `Layout::structure_of_arrays` the
+  links are converted once at the start and copied into the proposal by `finish`.
+
+  The fields of the chosen layout or precision and the scratch fields are kept
+  between trajectories, such that one state can be used for the whole chain.
+
+  Inside a parallel region every update has to be called by all threads of the
+  team, they share the sweeps over the lattice.
+  */
+class MdState {
+  public:
+    /**
+      Allocates the fields, `start` has to be called before the first update.
+
+      \param reunitarize_every With `Precision::mixed` the links are projected back
+      onto SU(2) after every this many link updates, zero for only at the end.
+      \param timers If not null, the force and link updates are timed.
+
+      \throws std::invalid_argument for `Precision::mixed` with a layout other than
+      `Layout::array_of_structures`.
+      */
+    MdState(Configuration &proposal,
+            MomentumConfiguration &momenta,
+            double const beta,
+            Layout const layout,
+            Precision const precision = Precision::full,
+            int const reunitarize_every = 10,
+            PhaseTimers *const timers = nullptr);
+
+    /**
+      State that starts a trajectory from the given links right away.
+      */
+    MdState(Configuration const &links,
+            Configuration &proposal,
+            MomentumConfiguration &momenta,
+            double const beta,
+            Layout const layout,
+            Precision const precision = Precision::full,
+            int const reunitarize_every = 10,
+            PhaseTimers *const timers = nullptr);
+
+    /**
+      Starts a trajectory from the given links and the current momenta.
+
+      This has to be called outside of a parallel region.
+      */
+    void start(Configuration const &links);
+
+    /**
+      Momentum update \f$ P \to P + \epsilon F(U) \f$.
+      */
+    void momentum_step(double const step);
+
+    /**
+      Link update \f$ U \to \exp(i \epsilon P) U \f$.
+      */
+    void link_step(double const step);
+
+    /**
+      Momentum update with the force evaluated at shifted links.
+
+      The links are temporarily moved to \f$ U' = \exp(i \delta F(U)) U \f$, then the
+      momenta are updated with \f$ \epsilon F(U') \f$. To leading order this adds the
+      force gradient term \f$ \epsilon \delta F \cdot \nabla F \f$ without computing
+      second derivatives of the action.
+      */
+    void force_gradient_step(double const step, double const shift);
+
+    /**
+      Ends the trajectory. With `Precision::mixed` the links are reunitarized and
+      copied into the proposal, the momenta into the double precision ones. With
+      `Layout::structure_of_arrays` the links are copied into the proposal.
+      Otherwise this does nothing.
+      */
+    void finish();
+
+    /**
+      Links at the current point of the trajectory.
+
+      With `Precision::mixed` or `Layout::structure_of_arrays` these are only up to
+      date after `finish`.
+      */
+    Configuration const &get_links() const { return *current; }
+
+    /**
+      Plaquette trace sum of the current links.
+
+      This is a by-product of the force computation. Only if the links have been
+      changed since the last momentum update it is computed from scratch.
+      */
+    double get_plaquette_trace_sum();
+
+    MomentumConfiguration const &get_momenta() const { return momenta; }
+
+    double get_beta() const { return beta; }
+
+    PhaseTimers *get_timers() const { return timers; }
+
+  private:
+    double momentum_step(Configuration const &links,
+                         MomentumConfiguration &target,
+                         double const step);
+
+    double momentum_step(SingleConfiguration const &links,
+                         SingleMomentumConfiguration &target,
+                         double const step);
+
+    double momentum_step(SoaConfiguration const &links,
+                         MomentumConfiguration &target,
+                         double const step);
+
+    /**
+      Force gradient update on the fields of either precision, `forces` and
+      `shifted_links` are scratch fields.
+      */
+    template <typename Links, typename Momenta>
+    void force_gradient_step(Links const &links,
+                             Momenta &momenta,
+                             Momenta &forces,
+                             Links &shifted_links,
+                             double const step,
+                             double const shift);
+
+    Configuration const *current;
+    Configuration &proposal;
+    MomentumConfiguration &momenta;
+    double beta;
+    PhaseTimers *timers;
+
+    double plaquette_trace_sum;
+    bool plaquette_trace_sum_valid;
+
+    /// Links of the structure-of-arrays layout during the whole trajectory. The
+    /// current links are in there unless `soa_current` is null, as it is after
+    /// `finish`.
+    std::unique_ptr<SoaConfiguration> soa_links;
+    SoaConfiguration *soa_current;
+    std::unique_ptr<SoaConfiguration> soa_shifted_links;
+
+    /// Scratch field for the plaquette-centric force kernel.
+    std::unique_ptr<Configuration> links_staples;
+
+    /// Temporary fields for the force gradient update, allocated on first use.
+    std::unique_ptr<MomentumConfiguration> forces;
+    std::unique_ptr<Configuration> shifted_links;
+
+    /// Fields of the single precision molecular dynamics, the current links are
+    /// either the first or the second one.
+    std::unique_ptr<SingleConfiguration> single_links;
+    std::unique_ptr<SingleConfiguration> single_proposal;
+    std::unique_ptr<SingleMomentumConfiguration> single_momenta;
+    SingleConfiguration const *single_current;
+    int reunitarize_every;
+    int link_steps;
+
+    std::unique_ptr<SingleMomentumConfiguration> single_forces;
+    std::unique_ptr<SingleConfiguration> single_shifted_links;
+};
+
+/**
+  Integration scheme for the molecular dynamics.
+  */
+class Integrator {
+  public:
+    virtual ~Integrator() {}
+
+    /**
+      Integrates `md_steps` steps of size `time_step`.
+
+      After this the state has been moved to the proposal links.
+      */
+    virtual void
+    integrate(MdState &state, double const time_step, int const md_steps) const = 0;
+
+    /**
+      Number of force evaluations per step, the cost of the integrator.
+      */
+    virtual int get_force_evaluations() const = 0;
+};
+
+/**
+  Symmetric splitting scheme given by a sequence of elementary updates per step.
+
+  The sequence has to start and end with momentum updates of the same size. Those
+  of adjacent steps are merged into one, such that this costs only one force
+  evaluation.
+  */
+class SplittingIntegrator : public Integrator {
+  public:
+    struct Update {
+        enum class Kind { momentum, link, force_gradient };
+
+        Kind kind;
+
+        /// Fraction of the time step.
+        double coefficient;
+
+        /// Link shift of the force gradient update in units of the squared time
+        /// step.
+        double shift;
+    };
+
+    explicit SplittingIntegrator(std::vector<Update> const &updates);
+
+    void
+    integrate(MdState &state, double const time_step, int const md_steps) const override;
+
+    int get_force_evaluations() const override;
+
+  private:
+    void apply(MdState &state, Update const &update, double const time_step) const;
+
+    std::vector<Update> updates;
+};
+
+/**
+  Creates the integrator with the given name.
+
+  Known are `leapfrog`, `omelyan` (second order 2MN), `omf4` (fourth order 4MN by
+  Omelyan, Mryglod and Folk) and `force-gradient` (fourth order with one force
+  gradient update).
+
+  \throws std::invalid_argument for an unknown name.
+  */
+std::unique_ptr<Integrator> make_integrator(std::string const &name);
@@ -1,15 +1,34 @@
 // Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
 
+#include "async-writer.hpp"
+#include "checkpoint.hpp"
+#include "gauge-file.hpp"
+#include "heatbath.hpp"
 #include "hybrid-monte-carlo.hpp"
+#include "integrator.hpp"
+#include "measurements.hpp"
+#include "metrics.hpp"
 #include "sanity-checks.hpp"
+#include "statistics.hpp"
+#include "step-size-tuner.hpp"
 
 #include <boost/format.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/filesystem.hpp>
 
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 //#define OUTPUT
 
@@ -24,87 +43,530 @@ void abort_if_dirty() {
     }
 }
 
-int main() {
-    abort_if_dirty();
+volatile std::sig_atomic_t termination_requested = 0;
+
+void request_termination(int) { termination_requested = 1; }
 
+int main() {
     std::cout << "sizeof(value_type): " << sizeof(Configuration::value_type) << std::endl;
 
     ptree::ptree config;
     try {
         ptree::read_ini("hmc.ini", config);
-    } catch (ptree::ini_parser::ini_parser_error e) {
+    } catch (ptree::ini_parser::ini_parser_error const &e) {
         std::cerr << e.what() << std::endl;
         abort();
     }
 
     bool const do_write_config = config.get<bool>("output.links", false);
+    GaugeCodec links_codec;
+    try {
+        links_codec = parse_gauge_codec(config.get<std::string>("output.codec", "double"));
+    } catch (std::invalid_argument const &e) {
+        std::cerr << e.what() << std::endl;
+        abort();
+    }
     double const beta = config.get<double>("md.beta");
     double const time_step = config.get<double>("md.time_step");
     int const chain_skip = config.get<int>("chain.skip");
     int const chain_total = config.get<int>("chain.total");
+    // With a target error the chain stops early once the plaquette has reached it,
+    // chain.total is then an upper limit.
+    double const target_error = config.get<double>("chain.target_error", 0.0);
     int const length_space = config.get<int>("lattice.length_space");
     int const length_time = config.get<int>("lattice.length_time");
     int const md_steps = config.get<int>("md.steps");
+    int const seed = config.get<int>("init.seed");
+
+    // An existing checkpoint means that this run continues an interrupted one.
+    std::string const checkpoint_path =
+        config.get<std::string>("checkpoint.path", "checkpoint.bin");
+    int const checkpoint_every = config.get<int>("checkpoint.every", 10);
+    int const output_queue = config.get<int>("output.queue", 4);
+    // Quiet runs print nothing per trajectory, metrics.jsonl has all of it.
+    bool const quiet = config.get<bool>("output.quiet", false);
+    if (output_queue < 1) {
+        std::cerr << "output.queue must be at least 1." << std::endl;
+        abort();
+    }
+    bool const resume = boost::filesystem::exists(checkpoint_path);
+    if (!resume) {
+        abort_if_dirty();
+    }
+
+    std::string const layout_name = config.get<std::string>("md.layout", "aos");
+    Layout layout;
+    if (layout_name == "aos") {
+        layout = Layout::array_of_structures;
+    } else if (layout_name == "soa") {
+        layout = Layout::structure_of_arrays;
+    } else if (layout_name == "plaquette") {
+        layout = Layout::plaquette;
+    } else {
+        std::cerr << "Unknown md.layout “" << layout_name
+                  << "”, must be “aos”, “soa” or “plaquette”." << std::endl;
+        abort();
+    }
+
+    // The molecular dynamics may run in single precision, the accept/reject step is
+    // always done in double precision.
+    std::string const precision_name = config.get<std::string>("md.precision", "double");
+    Precision precision;
+    if (precision_name == "double") {
+        precision = Precision::full;
+    } else if (precision_name == "mixed") {
+        precision = Precision::mixed;
+    } else {
+        std::cerr << "Unknown md.precision “" << precision_name
+                  << "”, must be “double” or “mixed”." << std::endl;
+        abort();
+    }
+    if (precision == Precision::mixed && layout != Layout::array_of_structures) {
+        std::cerr << "md.precision = mixed needs md.layout = aos." << std::endl;
+        abort();
+    }
+    int const reunitarize_every = config.get<int>("md.reunitarize_every", 10);
+    if (reunitarize_every < 0) {
+        std::cerr << "md.reunitarize_every must not be negative." << std::endl;
+        abort();
+    }
+
+    // Either HMC or heatbath with overrelaxation, both produce the same outputs.
+    std::string const algorithm = config.get<std::string>("chain.algorithm", "hmc");
+    if (algorithm != "hmc" && algorithm != "heatbath") {
+        std::cerr << "Unknown chain.algorithm “" << algorithm
+                  << "”, must be “hmc” or “heatbath”." << std::endl;
+        abort();
+    }
+    int const overrelaxation_steps = config.get<int>("heatbath.overrelaxation", 3);
+
+    std::string const integrator_name =
+        config.get<std::string>("md.integrator", "leapfrog");
+    std::unique_ptr<Integrator> integrator;
+    try {
+        integrator = make_integrator(integrator_name);
+    } catch (std::invalid_argument const &e) {
+        std::cerr << e.what() << std::endl;
+        abort();
+    }
+    if (algorithm == "hmc") {
+        std::cout << "Force evaluations per MD step: "
+                  << integrator->get_force_evaluations() << std::endl;
+    }
+
+    auto links = make_hot_start(
+        length_space, length_time, config.get<double>("init.hot_start_std"), seed);
+
+    std::vector<std::unique_ptr<Observable>> observables;
+    try {
+        observables = make_observables(config);
+    } catch (std::invalid_argument const &e) {
+        std::cerr << e.what() << std::endl;
+        abort();
+    }
+    int const measurement_every = config.get<int>("measurements.every", 1);
+    int const measurement_threads = config.get<int>("measurements.threads", 1);
+    if (measurement_every < 1 || measurement_threads < 1) {
+        std::cerr << "measurements.every and measurements.threads must be at least 1."
+                  << std::endl;
+        abort();
+    }
+    std::vector<std::string> measurement_names;
+    for (auto const &observable : observables) {
+        measurement_names.push_back(get_measurement_filename(*observable));
+    }
+
+    std::unique_ptr<Heatbath> heatbath;
+    if (algorithm == "heatbath") {
+        try {
+            heatbath.reset(new Heatbath(length_space, length_time, seed));
+        } catch (std::invalid_argument const &e) {
+            std::cerr << e.what() << std::endl;
+            abort();
+        }
+    }
+
+    // With a target acceptance the step size is tuned during the first
+    // trajectories and then frozen. These are left out of the online analysis.
+    double const target_acceptance = config.get<double>("md.target_acceptance", 0.0);
+    int const tune_trajectories = config.get<int>("md.tune_trajectories", 200);
+    std::unique_ptr<StepSizeTuner> tuner;
+    if (target_acceptance > 0 && !heatbath) {
+        try {
+            tuner.reset(new StepSizeTuner(time_step, md_steps, target_acceptance,
+                                          config.get<bool>("md.tune_fixed_length",
+                                                           false)));
+        } catch (std::invalid_argument const &e) {
+            std::cerr << e.what() << std::endl;
+            abort();
+        }
+    }
 
-    auto links = make_hot_start(length_space, length_time,
-                                config.get<double>("init.hot_start_std"),
-                                config.get<int>("init.seed"));
+    // A checkpoint is only continued by a run that would have produced the same
+    // chain. The numbers are written with enough digits to compare them exactly.
+    auto const format = [](double const value) {
+        std::ostringstream oss;
+        oss << std::setprecision(17) << value;
+        return oss.str();
+    };
+    ChainParameters parameters = {{"chain.algorithm", algorithm},
+                                  {"init.seed", std::to_string(seed)},
+                                  {"md.beta", format(beta)}};
+    if (heatbath) {
+        parameters["heatbath.overrelaxation"] = std::to_string(overrelaxation_steps);
+    } else {
+        parameters["md.integrator"] = integrator_name;
+        parameters["md.layout"] = layout_name;
+        parameters["md.precision"] = precision_name;
+        parameters["md.steps"] = std::to_string(md_steps);
+        parameters["md.time_step"] = format(time_step);
+    }
+
+    ChainState chain;
+    // Detects the thermalization and tracks the errors while the chain runs.
+    OnlineAnalysis analysis;
+    std::vector<std::string> const output_names = {"accept.tsv",
+                                                   "boltzmann.tsv",
+                                                   "metrics.jsonl",
+                                                   "plaquette.tsv",
+                                                   "plaquette-reject.tsv"};
+    if (resume) {
+        try {
+            load_checkpoint(checkpoint_path, chain, links);
+            check_parameters(chain.parameters, parameters);
+        } catch (std::runtime_error const &e) {
+            std::cerr << e.what() << std::endl;
+            abort();
+        }
+        if (chain.finished) {
+            std::cerr << "The chain in “" << checkpoint_path
+                      << "” is complete, aborting. To re-run this, delete the "
+                         "checkpoint and the output files."
+                      << std::endl;
+            abort();
+        }
+        if (!chain.analysis_state.empty()) {
+            std::istringstream iss(chain.analysis_state);
+            analysis.load_state(iss);
+        }
+        if (tuner && !chain.tuning_state.empty()) {
+            std::istringstream iss(chain.tuning_state);
+            tuner->load_state(iss);
+        }
 
+        // Drop the lines that were written after the checkpoint. Files that it does
+        // not list, for instance of a measurement enabled since, are left alone.
+        std::vector<std::string> names = output_names;
+        names.insert(names.end(), measurement_names.begin(), measurement_names.end());
+        for (auto const &name : names) {
+            auto const recorded = chain.output_sizes.find(name);
+            if (recorded != chain.output_sizes.end() && boost::filesystem::exists(name)) {
+                boost::filesystem::resize_file(name, recorded->second);
+            }
+        }
+        std::cout << "Resuming after trajectory " << chain.number_computed << "."
+                  << std::endl;
+        // The measurements run behind the chain, the last ones may not have been
+        // written at the time of the checkpoint.
+        int const last_due =
+            chain.number_computed - chain.number_computed % measurement_every;
+        for (auto const &entry : chain.measured_trajectories) {
+            if (entry.second < last_due) {
+                std::cout << "The measurements in " << entry.first << " after trajectory "
+                          << entry.second << " up to " << last_due << " are missing."
+                          << std::endl;
+            }
+        }
+    }
+    chain.parameters = parameters;
+
+    auto const mode = std::ios::out | (resume ? std::ios::app : std::ios::trunc);
+    std::ofstream ofs_accept("accept.tsv", mode);
+    std::ofstream ofs_boltzmann("boltzmann.tsv", mode);
+    std::ofstream ofs_plaquette("plaquette.tsv", mode);
+    std::ofstream ofs_plaquette_reject("plaquette-reject.tsv", mode);
+    std::ofstream ofs_metrics("metrics.jsonl", mode);
 
-    std::ofstream ofs_accept("accept.tsv");
-    std::ofstream ofs_boltzmann("boltzmann.tsv");
-    std::ofstream ofs_plaquette("plaquette.tsv");
-    std::ofstream ofs_plaquette_reject("plaquette-reject.tsv");
+    // Wall clock time per phase of the current trajectory.
+    PhaseTimers timers;
 
-    int number_stored = 0;
-    int number_computed = 0;
-    int number_accepted = 0;
+    // Everything that goes to disk is written by a background thread, the chain
+    // does not wait for the file system. The jobs get copies of the data. Only the
+    // writer thread touches the streams, they are flushed with every checkpoint.
+    AsyncWriter writer(output_queue);
+
+    // A failed write shows up at one of the next submissions.
+    auto submit_output = [&](std::function<void()> job) {
+        ScopedTimer const timer(&timers, Phase::io);
+        try {
+            writer.submit(std::move(job));
+        } catch (std::runtime_error const &e) {
+            std::cerr << e.what() << std::endl;
+            abort();
+        }
+    };
+
+    // The observables are measured on copies of the accepted links while the chain
+    // continues.
+    MeasurementPipeline measurements(
+        std::move(observables), resume, measurement_threads, output_queue);
+
+    auto write_checkpoint = [&]() {
+        // The measurements run behind the chain, it does not wait for them. Their
+        // files are cut back to the lines written so far, the trajectories after
+        // these stay unmeasured on restart.
+        std::vector<MeasurementProgress> const progress = measurements.get_progress();
+        for (size_t i = 0; i < progress.size(); ++i) {
+            chain.output_sizes[measurement_names[i]] = progress[i].size;
+            // Without a line from this run the one from the previous stays.
+            int &measured = chain.measured_trajectories[measurement_names[i]];
+            if (progress[i].trajectory > 0) {
+                measured = progress[i].trajectory;
+            }
+        }
+        {
+            std::ostringstream oss;
+            analysis.save_state(oss);
+            chain.analysis_state = oss.str();
+        }
+        if (tuner) {
+            std::ostringstream oss;
+            tuner->save_state(oss);
+            chain.tuning_state = oss.str();
+        }
+        // The jobs before have written all lines up to this trajectory.
+        submit_output([&, chain, links]() mutable {
+            for (auto *ofs : {&ofs_accept, &ofs_boltzmann, &ofs_metrics, &ofs_plaquette,
+                              &ofs_plaquette_reject}) {
+                ofs->flush();
+            }
+            for (auto const &name : output_names) {
+                chain.output_sizes[name] = boost::filesystem::file_size(name);
+            }
+            save_checkpoint(checkpoint_path, chain, links);
+        });
+    };
+
+    // A batch system sends SIGTERM before it kills the job. The current trajectory
+    // is finished and a checkpoint written, then the program exits.
+    std::signal(SIGTERM, request_termination);
 
     boost::format config_filename_format("gauge-links-%04d.bin");
 
-    std::mt19937 engine;
-    std::normal_distribution<double> dist(0, 1);
-    std::uniform_real_distribution<double> uniform(0, 1);
+    // The kinetic energy is the sum of the squared momentum coefficients, so the
+    // momenta have to be drawn with variance 1/2. They come from a counter-based
+    // generator keyed by the trajectory number.
+    double const momentum_std = std::sqrt(0.5);
+    MomentumConfiguration momenta(length_space, length_time);
 
-    while (number_computed < chain_total) {
-        Configuration const old_links = links;
-        double const energy_difference =
-            md_evolution(links, engine, dist, time_step, md_steps, beta);
-        ++number_computed;
+    // Double buffer, the trajectory is evolved into the proposal which replaces the
+    // links on acceptance.
+    Configuration proposal(length_space, length_time);
 
-        // Accept-Reject.
-        const bool accepted =
-            energy_difference <= 0 || std::exp(-energy_difference) >= uniform(engine);
-        if (accepted) {
-            std::cout << "Accepted.\n";
-            ++number_accepted;
+    // The fields of the molecular dynamics are allocated once for the whole chain.
+    std::unique_ptr<MdState> md_state;
+    if (!heatbath) {
+        md_state.reset(new MdState(proposal, momenta, beta, layout, precision,
+                                   reunitarize_every, &timers));
+    }
+
+    // The plaquette trace sum of the current links is kept across trajectories. For
+    // HMC the one of the proposal is a by-product of the last force evaluation.
+    double plaquette_trace_sum = get_plaquette_trace_sum(links).real();
+    double proposal_plaquette_trace_sum = 0.0;
+
+    // The time for writing a record and a checkpoint is part of the next record.
+    auto record_begin = std::chrono::steady_clock::now();
+
+    auto target_reached = [&]() {
+        return target_error > 0 && analysis.has_reached(target_error);
+    };
+
+    while (chain.number_computed < chain_total && !target_reached()) {
+        double energy_difference = 0.0;
+        bool accepted = true;
+        bool const tuning = tuner && !tuner->is_frozen();
+        double const trajectory_time_step = tuner ? tuner->get_time_step() : time_step;
+        int const trajectory_md_steps = tuner ? tuner->get_steps() : md_steps;
+        if (heatbath) {
+            // Heatbath updates work in place and are always accepted, they are
+            // recorded with a vanishing energy difference.
+            ScopedTimer const timer(&timers, Phase::heatbath);
+            heatbath->update(links, beta, overrelaxation_steps, chain.number_computed);
+            plaquette_trace_sum = get_plaquette_trace_sum(links).real();
         } else {
-            std::cout << "Rejected.\n";
+            {
+                ScopedTimer const timer(&timers, Phase::momentum_refresh);
+                randomize_algebra(momenta,
+                                  CounterRng(seed, CounterRng::Purpose::momenta,
+                                             chain.number_computed),
+                                  momentum_std);
+            }
+            energy_difference = md_evolution(
+                *md_state, links, *integrator, trajectory_time_step, trajectory_md_steps,
+                plaquette_trace_sum, proposal_plaquette_trace_sum);
+            if (!quiet) {
+                std::cout << "HMD ΔE = " << energy_difference << "\n";
+            }
+
+            // Accept-Reject.
+            accepted = energy_difference <= 0 ||
+                       std::exp(-energy_difference) >= chain.uniform(chain.engine);
+            if (accepted) {
+                std::swap(links, proposal);
+                plaquette_trace_sum = proposal_plaquette_trace_sum;
+            }
+        }
+        ++chain.number_computed;
+
+        if (tuning) {
+            tuner->update(energy_difference);
+            if (tuner->get_count() >= tune_trajectories) {
+                tuner->freeze();
+                std::cout << "Tuned after " << tuner->get_count()
+                          << " trajectories with a mean acceptance of "
+                          << tuner->get_acceptance()
+                          << ": md.time_step = " << tuner->get_time_step()
+                          << ", md.steps = " << tuner->get_steps() << std::endl;
+            }
+        }
 
-            ofs_plaquette_reject << number_computed << "\t"
-                                 << get_plaquette_trace_average(links).real()
-                                 << std::endl;
+        if (accepted) {
+            if (!quiet) {
+                std::cout << "Accepted.\n";
+            }
+            ++chain.number_accepted;
+        } else {
+            if (!quiet) {
+                std::cout << "Rejected.\n";
+            }
 
-            links = old_links;
+            int const number_computed = chain.number_computed;
+            double const proposal_plaquette =
+                get_plaquette_trace_average(links.get_volume(),
+                                            proposal_plaquette_trace_sum)
+                    .real();
+            submit_output([&, number_computed, proposal_plaquette]() {
+                ofs_plaquette_reject << number_computed << "\t" << proposal_plaquette
+                                     << "\n";
+            });
         }
 
         if (do_write_config &&
-            (chain_skip == 0 || number_computed % chain_skip == 0)) {
-            std::string filename = (config_filename_format %
-           number_stored).str();
-            links.save(filename);
-            ++number_stored;
+            (chain_skip == 0 || chain.number_computed % chain_skip == 0)) {
+            std::string const filename =
+                (config_filename_format % chain.number_stored).str();
+            int const trajectory = chain.number_computed;
+            submit_output([=]() {
+                save_gauge_file(filename, links, beta, trajectory, links_codec);
+            });
+            ++chain.number_stored;
         }
 
         auto const acceptance_rate =
-            static_cast<double>(number_accepted) / number_computed;
-        std::cout << "Acceptance rate: " << number_accepted << " / " << number_computed
-                  << " = " << acceptance_rate << "\n"
-                  << std::endl;
+            static_cast<double>(chain.number_accepted) / chain.number_computed;
+        if (!quiet) {
+            std::cout << "Acceptance rate: " << chain.number_accepted << " / "
+                      << chain.number_computed << " = " << acceptance_rate << "\n\n";
+        }
+
+        int const number_computed = chain.number_computed;
+        double const average_plaquette =
+            get_plaquette_trace_average(links.get_volume(), plaquette_trace_sum).real();
+        submit_output([&, accepted, energy_difference, number_computed,
+                       average_plaquette]() {
+            ofs_accept << (accepted ? 1 : 0) << "\n";
+            ofs_boltzmann << energy_difference << "\n";
+            ofs_plaquette << number_computed << "\t" << average_plaquette << "\n";
+        });
 
-        double const average_plaquette = get_plaquette_trace_average(links).real();
-        ofs_accept << (accepted ? 1 : 0) << std::endl;
-        ofs_boltzmann << energy_difference << std::endl;
-        ofs_plaquette << number_computed << "\t" << average_plaquette << std::endl;
+        if (!measurement_names.empty() &&
+            chain.number_computed % measurement_every == 0) {
+            try {
+                ScopedTimer const timer(&timers, Phase::measurements);
+                measurements.submit(chain.number_computed, links);
+            } catch (std::runtime_error const &e) {
+                std::cerr << e.what() << std::endl;
+                abort();
+            }
+        }
+
+        if (!tuning) {
+            bool const was_thermalized = analysis.is_thermalized();
+            analysis.add(average_plaquette, energy_difference);
+            if (!was_thermalized && analysis.is_thermalized()) {
+                int const tuned = tuner ? tuner->get_count() : 0;
+                std::cout << "Thermalized, the first "
+                          << tuned + analysis.get_thermalization()
+                          << " trajectories are discarded from the analysis."
+                          << std::endl;
+            }
+        }
+
+        TrajectoryMetrics metrics;
+        metrics.trajectory = chain.number_computed;
+        metrics.accepted = accepted;
+        metrics.energy_difference = energy_difference;
+        metrics.acceptance_rate = acceptance_rate;
+        metrics.plaquette = average_plaquette;
+        metrics.thermalized = analysis.is_thermalized();
+        metrics.plaquette_error = analysis.get_plaquette().get_error();
+        metrics.tuning = tuning;
+        metrics.time_step = heatbath ? std::nan("") : trajectory_time_step;
+        metrics.md_steps = heatbath ? 0 : trajectory_md_steps;
+        auto const record_end = std::chrono::steady_clock::now();
+        metrics.seconds =
+            std::chrono::duration<double>(record_end - record_begin).count();
+        metrics.phases = timers;
+        timers.reset();
+        record_begin = record_end;
+        submit_output([&, metrics]() { ofs_metrics << to_json(metrics) << "\n"; });
+
+        bool const terminate = termination_requested;
+        bool const finished = chain.number_computed == chain_total || target_reached();
+        if (terminate || finished) {
+            // The last checkpoint includes all measurements.
+            try {
+                ScopedTimer const timer(&timers, Phase::measurements);
+                measurements.wait();
+            } catch (std::runtime_error const &e) {
+                std::cerr << e.what() << std::endl;
+                abort();
+            }
+        }
+        if (terminate || finished ||
+            (checkpoint_every > 0 && chain.number_computed % checkpoint_every == 0)) {
+            chain.finished = finished;
+            write_checkpoint();
+        }
+        if (terminate || finished) {
+            try {
+                writer.wait();
+            } catch (std::runtime_error const &e) {
+                std::cerr << e.what() << std::endl;
+                abort();
+            }
+        }
+        if (terminate) {
+            std::cout << "Terminated after trajectory " << chain.number_computed
+                      << ", checkpoint written." << std::endl;
+            return 0;
+        }
+    }
+
+    if (target_reached()) {
+        std::cout << "Target error " << target_error << " reached after trajectory "
+                  << chain.number_computed << "." << std::endl;
+    }
+    if (analysis.is_thermalized()) {
+        BinningAnalysis const &plaquette = analysis.get_plaquette();
+        BinningAnalysis const &boltzmann = analysis.get_boltzmann();
+        std::cout << "Plaquette " << plaquette.get_mean() << " ± "
+                  << plaquette.get_error() << " with tau_int "
+                  << plaquette.get_tau_int() << ", <exp(-ΔH)> " << boltzmann.get_mean()
+                  << " ± " << boltzmann.get_error() << " from "
+                  << plaquette.get_count() << " trajectories." << std::endl;
+    } else {
+        std::cout << "The chain has not thermalized yet." << std::endl;
     }
 }
@@ -2,8 +2,14 @@
 
 #pragma once
 
+// GCC 12 reports -Wuninitialized and -Wmaybe-uninitialized inside its own
+// AVX-512 intrinsics (_mm512_broadcast_f64x2) as Eigen uses them for complex
+// matrices with -march=native. Only the Eigen headers are exempted.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
 #include <Eigen/Dense>
-#include <unsupported/Eigen/MatrixFunctions>
+#pragma GCC diagnostic pop
 
 #include <complex>
 
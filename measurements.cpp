@@ -0,0 +1,250 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "measurements.hpp"
+
+#include "hybrid-monte-carlo.hpp"
+#include "parallel.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/**
+  Average of ½ tr P over the planes (mu, nu) with `first_mu <= mu` and `nu < mu`,
+  restricted to `nu >= first_nu`.
+  */
+double get_plaquette_average(Configuration const &links,
+                             int const first_mu,
+                             int const first_nu) {
+    int planes = 0;
+    for (int mu = first_mu; mu < 4; ++mu) {
+        for (int nu = first_nu; nu < mu; ++nu) {
+            ++planes;
+        }
+    }
+
+    double const sum = parallel_sum([&](double &partial) {
+#pragma omp for schedule(static)
+        for (int site = 0; site < links.get_volume(); ++site) {
+            for (int mu = first_mu; mu < 4; ++mu) {
+                for (int nu = first_nu; nu < mu; ++nu) {
+                    partial += get_plaquette(site, mu, nu, links).trace();
+                }
+            }
+        }
+    });
+    return sum / (2.0 * planes * links.get_volume());
+}
+}  // namespace
+
+std::vector<double> PlaquetteObservable::measure(Configuration const &links) const {
+    // Temporal planes have nu = 0, spatial ones 1 <= nu < mu.
+    double const spatial = get_plaquette_average(links, 2, 1);
+    double const all = get_plaquette_trace_average(links).real();
+    double const temporal = 2 * all - spatial;
+    return {all, spatial, temporal};
+}
+
+std::vector<double> PolyakovLoopObservable::measure(Configuration const &links) const {
+    std::vector<double> const loops = get_polyakov_loops(links);
+    double sum = 0.0;
+    for (double const loop : loops) {
+        sum += loop;
+    }
+    return {sum / loops.size()};
+}
+
+PolyakovCorrelatorObservable::PolyakovCorrelatorObservable(int const r_max)
+    : r_max(r_max) {
+    if (r_max < 0) {
+        throw std::invalid_argument("The Polyakov loop correlator needs r_max ≥ 0.");
+    }
+}
+
+std::vector<double>
+PolyakovCorrelatorObservable::measure(Configuration const &links) const {
+    return get_polyakov_correlator(links, r_max);
+}
+
+WilsonLoopsObservable::WilsonLoopsObservable(int const length_space,
+                                             int const length_time,
+                                             int const r_max,
+                                             int const t_max)
+    : engine(length_space, length_time, r_max, t_max) {}
+
+std::vector<double> WilsonLoopsObservable::measure(Configuration const &links) const {
+    return engine.measure(links);
+}
+
+std::vector<double> EnergyDensityObservable::measure(Configuration const &links) const {
+    // Six planes per site.
+    double const plaquette = get_plaquette_trace_average(links).real();
+    return {2 * 6 * number_of_colors * (1 - plaquette)};
+}
+
+WilsonFlowObservable::WilsonFlowObservable(int const length_space,
+                                           int const length_time,
+                                           std::vector<double> const &flow_times,
+                                           double const step,
+                                           double const tolerance)
+    : flow_times(flow_times),
+      step(step),
+      flow(length_space, length_time, step, tolerance),
+      flowed(length_space, length_time) {
+    if (flow_times.empty()) {
+        throw std::invalid_argument("The Wilson flow needs at least one flow time.");
+    }
+    double previous = 0.0;
+    for (double const flow_time : flow_times) {
+        if (!(flow_time > previous)) {
+            throw std::invalid_argument("The flow times must be positive, increasing.");
+        }
+        previous = flow_time;
+    }
+}
+
+std::vector<double> WilsonFlowObservable::measure(Configuration const &links) const {
+    flowed = links;
+    flow.set_step(step);
+
+    std::vector<double> result;
+    double current = 0.0;
+    for (double const flow_time : flow_times) {
+        flow.flow(flowed, flow_time - current);
+        current = flow_time;
+
+        CloverObservables const clover = measure_clover(flowed);
+        result.push_back(flow_time * flow_time * clover.energy_density);
+        result.push_back(clover.topological_charge);
+    }
+    return result;
+}
+
+std::unique_ptr<Observable> make_observable(std::string const &name,
+                                            boost::property_tree::ptree const &config) {
+    if (name == "plaquette") {
+        return std::unique_ptr<Observable>(new PlaquetteObservable());
+    } else if (name == "polyakov-loop") {
+        return std::unique_ptr<Observable>(new PolyakovLoopObservable());
+    } else if (name == "polyakov-correlator") {
+        return std::unique_ptr<Observable>(new PolyakovCorrelatorObservable(
+            config.get<int>("polyakov-correlator.r_max", 4)));
+    } else if (name == "wilson-loops") {
+        return std::unique_ptr<Observable>(
+            new WilsonLoopsObservable(config.get<int>("lattice.length_space"),
+                                      config.get<int>("lattice.length_time"),
+                                      config.get<int>("wilson-loops.r_max", 4),
+                                      config.get<int>("wilson-loops.t_max", 4)));
+    } else if (name == "energy-density") {
+        return std::unique_ptr<Observable>(new EnergyDensityObservable());
+    } else if (name == "wilson-flow") {
+        std::vector<double> flow_times;
+        std::istringstream iss(config.get<std::string>("wilson-flow.times", "1"));
+        double flow_time;
+        while (iss >> flow_time) {
+            flow_times.push_back(flow_time);
+        }
+        return std::unique_ptr<Observable>(
+            new WilsonFlowObservable(config.get<int>("lattice.length_space"),
+                                     config.get<int>("lattice.length_time"),
+                                     flow_times,
+                                     config.get<double>("wilson-flow.step", 0.01),
+                                     config.get<double>("wilson-flow.tolerance", 0.0)));
+    }
+
+    throw std::invalid_argument("Unknown observable “" + name +
+                                "”, must be “plaquette”, “polyakov-loop”, "
+                                "“polyakov-correlator”, “wilson-loops”, "
+                                "“energy-density” or “wilson-flow”.");
+}
+
+std::vector<std::unique_ptr<Observable>>
+make_observables(boost::property_tree::ptree const &config) {
+    std::vector<std::unique_ptr<Observable>> observables;
+    std::istringstream names(config.get<std::string>("measurements.observables", ""));
+    std::string name;
+    while (names >> name) {
+        observables.push_back(make_observable(name, config));
+    }
+    return observables;
+}
+
+std::string get_measurement_filename(Observable const &observable) {
+    return "measurement-" + observable.get_name() + ".tsv";
+}
+
+MeasurementPipeline::MeasurementPipeline(
+    std::vector<std::unique_ptr<Observable>> observables,
+    bool const append,
+    int const threads,
+    int const capacity)
+    : observables(std::move(observables)), threads(threads), worker(capacity) {
+    auto const mode = std::ios::out | (append ? std::ios::app : std::ios::trunc);
+    for (auto const &observable : this->observables) {
+        streams.emplace_back(
+            new std::ofstream(get_measurement_filename(*observable), mode));
+        // Appended lines start at the end of what is already there. A file that
+        // could not be opened fails at the first write.
+        std::ofstream &stream = *streams.back();
+        stream.seekp(0, std::ios::end);
+        std::streamoff const end = stream.tellp();
+        progress.push_back({0, end > 0 ? static_cast<std::uintmax_t>(end) : 0});
+    }
+}
+
+void MeasurementPipeline::submit(int const trajectory, Configuration const &links) {
+    worker.submit([this, trajectory, links]() {
+#ifdef _OPENMP
+        // The number of threads is a setting of the calling thread, this one.
+        omp_set_num_threads(threads);
+#endif
+        for (size_t i = 0; i < observables.size(); ++i) {
+            std::ostringstream line;
+            line << trajectory;
+            for (double const value : observables[i]->measure(links)) {
+                line << "\t" << value;
+            }
+            line << "\n";
+
+            std::ostream &os = *streams[i];
+            std::string const text = line.str();
+            os << text;
+            os.flush();
+            if (!os) {
+                throw std::runtime_error("Could not write “" +
+                                         get_measurement_filename(*observables[i]) +
+                                         "”.");
+            }
+
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            progress[i].trajectory = trajectory;
+            progress[i].size += text.size();
+        }
+    });
+}
+
+void MeasurementPipeline::wait() {
+    worker.wait();
+    for (auto &stream : streams) {
+        stream->flush();
+    }
+}
+
+std::vector<MeasurementProgress> MeasurementPipeline::get_progress() const {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    return progress;
+}
+
+std::vector<std::string> MeasurementPipeline::get_output_names() const {
+    std::vector<std::string> names;
+    for (auto const &observable : observables) {
+        names.push_back(get_measurement_filename(*observable));
+    }
+    return names;
+}
@@ -0,0 +1,248 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Observables that are measured on the accepted configurations.
+///
+/// The observables are chosen by name in the `[measurements]` section of
+/// `hmc.ini`, each one may have a section of its own for parameters. Direction 0
+/// is time, 1 to 3 are space.
+
+#pragma once
+
+#include "async-writer.hpp"
+#include "configuration.hpp"
+#include "wilson-flow.hpp"
+#include "wilson-loops.hpp"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+  Quantity that is measured on a gauge configuration.
+  */
+class Observable {
+  public:
+    virtual ~Observable() {}
+
+    /**
+      Name used in the configuration and in the output file name.
+      */
+    virtual std::string get_name() const = 0;
+
+    /**
+      Measures on the given links, the values form one line of the output.
+
+      This may use OpenMP, but is not called from within a parallel region.
+      */
+    virtual std::vector<double> measure(Configuration const &links) const = 0;
+};
+
+/**
+  Average plaquette \f$ \frac12 \operatorname{tr} P_{\mu\nu} \f$: over all planes,
+  the spatial and the temporal ones.
+  */
+class PlaquetteObservable : public Observable {
+  public:
+    std::string get_name() const override { return "plaquette"; }
+    std::vector<double> measure(Configuration const &links) const override;
+};
+
+/**
+  Spatial average of the Polyakov loop \f$ \frac12 \operatorname{tr} \prod_t
+  U_0(t, \vec x) \f$, which is real for SU(2).
+  */
+class PolyakovLoopObservable : public Observable {
+  public:
+    std::string get_name() const override { return "polyakov-loop"; }
+    std::vector<double> measure(Configuration const &links) const override;
+};
+
+/**
+  Polyakov loop correlator \f$ \langle P(\vec x) P(\vec x + r \hat\imath) \rangle
+  \f$ for r = 0, …, r_max.
+  */
+class PolyakovCorrelatorObservable : public Observable {
+  public:
+    /**
+      \throws std::invalid_argument if `r_max` is negative.
+      */
+    explicit PolyakovCorrelatorObservable(int const r_max);
+
+    std::string get_name() const override { return "polyakov-correlator"; }
+    std::vector<double> measure(Configuration const &links) const override;
+
+  private:
+    int r_max;
+};
+
+/**
+  Average \f$ \frac12 \operatorname{tr} W(R, T) \f$ of the rectangular loops with
+  spatial extent R and temporal extent T.
+
+  The values are ordered with T running fastest: W(1, 1), W(1, 2), …, W(1,
+  t_max), W(2, 1), … The scratch fields of the engine are reused, so the
+  measurements of one observable must not run concurrently.
+  */
+class WilsonLoopsObservable : public Observable {
+  public:
+    /**
+      \throws std::invalid_argument if the sizes do not fit the lattice.
+      */
+    WilsonLoopsObservable(int const length_space,
+                          int const length_time,
+                          int const r_max,
+                          int const t_max);
+
+    std::string get_name() const override { return "wilson-loops"; }
+    std::vector<double> measure(Configuration const &links) const override;
+
+  private:
+    mutable WilsonLoopEngine engine;
+};
+
+/**
+  Action density \f$ E = 2 \sum_{\mu<\nu} (N - \operatorname{tr} P_{\mu\nu}) \f$ per
+  site, in lattice units. Its continuum limit is \f$ \frac14 G^a_{\mu\nu}
+  G^a_{\mu\nu} \f$.
+  */
+class EnergyDensityObservable : public Observable {
+  public:
+    std::string get_name() const override { return "energy-density"; }
+    std::vector<double> measure(Configuration const &links) const override;
+};
+
+/**
+  Clover observables along the Wilson flow: \f$ t^2 \langle E \rangle \f$ and the
+  topological charge Q at each of the given flow times, in this order.
+
+  The links are copied into a field of the observable and flowed there, so the
+  measurements of one observable must not run concurrently.
+  */
+class WilsonFlowObservable : public Observable {
+  public:
+    /**
+      \param flow_times Increasing flow times in lattice units.
+      \param step Initial step size for every configuration.
+      \param tolerance Tolerance of the adaptive step size, zero for a fixed one.
+
+      \throws std::invalid_argument for no flow times, flow times that are not
+      increasing and positive, or invalid step parameters.
+      */
+    WilsonFlowObservable(int const length_space,
+                         int const length_time,
+                         std::vector<double> const &flow_times,
+                         double const step,
+                         double const tolerance);
+
+    std::string get_name() const override { return "wilson-flow"; }
+    std::vector<double> measure(Configuration const &links) const override;
+
+  private:
+    std::vector<double> flow_times;
+    double step;
+
+    mutable WilsonFlow flow;
+    mutable Configuration flowed;
+};
+
+/**
+  Creates the observable with the given name.
+
+  Known are `plaquette`, `polyakov-loop`, `polyakov-correlator` (parameter `r_max`
+  in the section `[polyakov-correlator]`, default 4), `wilson-loops` (parameters
+  `r_max` and `t_max` in the section `[wilson-loops]`, default 4),
+  `energy-density` and `wilson-flow` (parameters `times`, a list separated by
+  spaces, `step`, default 0.01, and `tolerance`, default 0, in the section
+  `[wilson-flow]`). The lattice extents are taken from the section `[lattice]`.
+
+  \throws std::invalid_argument for an unknown name or invalid parameters.
+  */
+std::unique_ptr<Observable> make_observable(std::string const &name,
+                                            boost::property_tree::ptree const &config);
+
+/**
+  Creates the observables listed, separated by spaces, in `measurements.observables`.
+
+  \throws std::invalid_argument for an unknown name or invalid parameters.
+  */
+std::vector<std::unique_ptr<Observable>>
+make_observables(boost::property_tree::ptree const &config);
+
+/**
+  Name of the file that the values of an observable are written to.
+  */
+std::string get_measurement_filename(Observable const &observable);
+
+/**
+  How far the file of an observable has been written.
+  */
+struct MeasurementProgress {
+    /// Trajectory of the last line, zero if none has been written by this run.
+    int trajectory;
+
+    /// Size of the file up to and including that line.
+    std::uintmax_t size;
+};
+
+/**
+  Measures the observables on a background thread while the chain continues.
+
+  Every submitted configuration is copied, measured and one line `trajectory
+  values…` is appended to the file of every observable. The measurements may use
+  their own OpenMP threads, by default they run on a single one such that they do
+  not compete with the molecular dynamics.
+  */
+class MeasurementPipeline {
+  public:
+    /**
+      \param append Append to existing output files instead of replacing them.
+      \param threads OpenMP threads used for the measurements.
+      \param capacity Number of configurations that may wait to be measured.
+      */
+    MeasurementPipeline(std::vector<std::unique_ptr<Observable>> observables,
+                        bool const append,
+                        int const threads,
+                        int const capacity);
+
+    /**
+      Queues a measurement, blocks only while `capacity` are already waiting.
+
+      \throws std::runtime_error if an earlier measurement or write failed.
+      */
+    void submit(int const trajectory, Configuration const &links);
+
+    /**
+      Blocks until all measurements are done and flushes the output files.
+
+      \throws std::runtime_error if a measurement or write failed.
+      */
+    void wait();
+
+    std::vector<std::string> get_output_names() const;
+
+    /**
+      Progress of the file of every observable, in the order of the output names.
+
+      This does not wait for pending measurements. Every line up to the returned
+      size has been flushed, so the files can be cut back to it after a restart.
+      */
+    std::vector<MeasurementProgress> get_progress() const;
+
+  private:
+    std::vector<std::unique_ptr<Observable>> observables;
+    std::vector<std::unique_ptr<std::ofstream>> streams;
+    int threads;
+
+    /// Written by the worker after every line, read by the chain.
+    std::vector<MeasurementProgress> progress;
+    mutable std::mutex progress_mutex;
+
+    /// Declared last such that it finishes the jobs before the streams close.
+    AsyncWriter worker;
+};
@@ -0,0 +1,102 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "metrics.hpp"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+void write_number(std::ostream &os, double const value) {
+    if (std::isfinite(value)) {
+        os << value;
+    } else {
+        os << "null";
+    }
+}
+}  // namespace
+
+std::string get_phase_name(Phase const phase) {
+    switch (phase) {
+        case Phase::momentum_refresh:
+            return "momentum_refresh";
+        case Phase::force:
+            return "force";
+        case Phase::link:
+            return "link";
+        case Phase::energy:
+            return "energy";
+        case Phase::heatbath:
+            return "heatbath";
+        case Phase::measurements:
+            return "measurements";
+        case Phase::io:
+            return "io";
+    }
+    return "";
+}
+
+void PhaseTimers::reset() {
+    for (int i = 0; i < number_of_phases; ++i) {
+        seconds[i] = 0.0;
+        calls[i] = 0;
+    }
+}
+
+ScopedTimer::ScopedTimer(PhaseTimers *const timers, Phase const phase)
+    : timers(timers), phase(phase) {
+#ifdef _OPENMP
+    if (omp_get_thread_num() != 0) {
+        this->timers = nullptr;
+    }
+#endif
+    if (this->timers) {
+        begin = std::chrono::steady_clock::now();
+    }
+}
+
+ScopedTimer::~ScopedTimer() {
+    if (timers) {
+        std::chrono::duration<double> const elapsed =
+            std::chrono::steady_clock::now() - begin;
+        timers->add(phase, elapsed.count());
+    }
+}
+
+std::string to_json(TrajectoryMetrics const &metrics) {
+    std::ostringstream oss;
+    oss.precision(std::numeric_limits<double>::max_digits10);
+    oss << "{\"trajectory\": " << metrics.trajectory
+        << ", \"accepted\": " << (metrics.accepted ? "true" : "false")
+        << ", \"delta_h\": ";
+    write_number(oss, metrics.energy_difference);
+    oss << ", \"acceptance_rate\": ";
+    write_number(oss, metrics.acceptance_rate);
+    oss << ", \"plaquette\": ";
+    write_number(oss, metrics.plaquette);
+    oss << ", \"thermalized\": " << (metrics.thermalized ? "true" : "false")
+        << ", \"plaquette_error\": ";
+    write_number(oss, metrics.plaquette_error);
+    oss << ", \"tuning\": " << (metrics.tuning ? "true" : "false")
+        << ", \"time_step\": ";
+    write_number(oss, metrics.time_step);
+    oss << ", \"md_steps\": " << metrics.md_steps;
+    oss << ", \"seconds\": ";
+    write_number(oss, metrics.seconds);
+
+    oss << ", \"phases\": {";
+    for (int i = 0; i < number_of_phases; ++i) {
+        Phase const phase = static_cast<Phase>(i);
+        oss << (i == 0 ? "" : ", ") << "\"" << get_phase_name(phase)
+            << "\": {\"seconds\": ";
+        write_number(oss, metrics.phases.get_seconds(phase));
+        oss << ", \"calls\": " << metrics.phases.get_calls(phase) << "}";
+    }
+    oss << "}}";
+    return oss.str();
+}
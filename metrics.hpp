@@ -0,0 +1,125 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Wall clock timers for the phases of a trajectory and the record that is written
+/// for every trajectory.
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+/**
+  Parts of a trajectory that are timed separately.
+  */
+enum class Phase {
+    /// Drawing the momenta.
+    momentum_refresh,
+    /// Force evaluations with the momentum updates.
+    force,
+    /// Link updates.
+    link,
+    /// Kinetic and gauge energies for the accept/reject step.
+    energy,
+    /// Heatbath and overrelaxation sweeps.
+    heatbath,
+    /// Handing configurations to the measurements and waiting for them.
+    measurements,
+    /// Handing data to the output thread and waiting for it.
+    io
+};
+
+int constexpr number_of_phases = 7;
+
+/**
+  Name of the phase in the records, like `momentum_refresh`.
+  */
+std::string get_phase_name(Phase const phase);
+
+/**
+  Accumulated wall clock time and number of timed scopes per phase.
+  */
+class PhaseTimers {
+  public:
+    PhaseTimers() { reset(); }
+
+    void add(Phase const phase, double const seconds) {
+        this->seconds[static_cast<int>(phase)] += seconds;
+        ++calls[static_cast<int>(phase)];
+    }
+
+    double get_seconds(Phase const phase) const {
+        return seconds[static_cast<int>(phase)];
+    }
+
+    int get_calls(Phase const phase) const { return calls[static_cast<int>(phase)]; }
+
+    void reset();
+
+  private:
+    double seconds[number_of_phases];
+    int calls[number_of_phases];
+};
+
+/**
+  Adds the wall clock time of its scope to a phase.
+
+  Within a parallel region only the master thread takes the time. The sweeps end
+  with a barrier, so this is the wall clock time of the whole team. With a null
+  pointer nothing is timed. Reading the clock costs some tens of nanoseconds, the
+  timers are meant for whole sweeps.
+  */
+class ScopedTimer {
+  public:
+    ScopedTimer(PhaseTimers *const timers, Phase const phase);
+    ~ScopedTimer();
+
+    ScopedTimer(ScopedTimer const &) = delete;
+    ScopedTimer &operator=(ScopedTimer const &) = delete;
+
+  private:
+    PhaseTimers *timers;
+    Phase phase;
+    std::chrono::steady_clock::time_point begin;
+};
+
+/**
+  Everything that is recorded about one trajectory.
+  */
+struct TrajectoryMetrics {
+    int trajectory;
+    bool accepted;
+    double energy_difference;
+    double acceptance_rate;
+    double plaquette;
+
+    /// Whether the online analysis has detected the end of the thermalization.
+    bool thermalized;
+    /// Error of the plaquette after the thermalization, not finite before.
+    double plaquette_error;
+
+    /// Whether the step size was still being tuned.
+    bool tuning;
+    /// Molecular dynamics parameters of the trajectory, not finite and zero for
+    /// the heatbath.
+    double time_step;
+    int md_steps;
+
+    /// Wall clock time since the previous record, the trajectory with all
+    /// bookkeeping.
+    double seconds;
+
+    PhaseTimers phases;
+};
+
+/**
+  Formats the metrics as one line of JSON without the newline, for instance
+
+      {"trajectory": 12, "accepted": true, "delta_h": 0.13, "acceptance_rate": 0.75,
+       "plaquette": 0.61, "thermalized": true, "plaquette_error": 0.002,
+       "tuning": false, "time_step": 0.1, "md_steps": 10, "seconds": 0.52,
+       "phases": {"force": {"seconds": 0.31, "calls": 21}, …}}
+
+  Numbers that are not finite are written as `null`.
+  */
+std::string to_json(TrajectoryMetrics const &metrics);
@@ -0,0 +1,62 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "neighbor-table.hpp"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+NeighborTable::NeighborTable(int const length_space, int const length_time)
+    : volume(length_space * length_space * length_space * length_time),
+      padded_volume((volume + padding - 1) / padding * padding),
+      indices((4 + 4 + 4 * 4) * padded_volume, 0) {
+    int const extents[4] = {length_time, length_space, length_space, length_space};
+
+    auto site_index = [&extents](int const *const coords) {
+        int site = 0;
+        for (int d = 0; d < 4; ++d) {
+            site = site * extents[d] + (coords[d] + extents[d]) % extents[d];
+        }
+        return site;
+    };
+
+    int coords[4];
+    for (int site = 0; site < volume; ++site) {
+        int rest = site;
+        for (int d = 3; d >= 0; --d) {
+            coords[d] = rest % extents[d];
+            rest /= extents[d];
+        }
+
+        for (int mu = 0; mu < 4; ++mu) {
+            ++coords[mu];
+            indices[mu * padded_volume + site] = site_index(coords);
+            coords[mu] -= 2;
+            indices[(4 + mu) * padded_volume + site] = site_index(coords);
+            ++coords[mu];
+
+            for (int nu = 0; nu < 4; ++nu) {
+                ++coords[mu];
+                --coords[nu];
+                indices[(8 + 4 * mu + nu) * padded_volume + site] = site_index(coords);
+                --coords[mu];
+                ++coords[nu];
+            }
+        }
+    }
+}
+
+std::shared_ptr<NeighborTable const> NeighborTable::get(int const length_space,
+                                                        int const length_time) {
+    static std::mutex mutex;
+    static std::map<std::pair<int, int>, std::weak_ptr<NeighborTable const>> cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &entry = cache[std::make_pair(length_space, length_time)];
+    auto table = entry.lock();
+    if (!table) {
+        table = std::make_shared<NeighborTable const>(length_space, length_time);
+        entry = table;
+    }
+    return table;
+}
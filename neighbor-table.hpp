@@ -0,0 +1,68 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+/**
+  Precomputed site indices of the neighbors with periodic boundary conditions.
+
+  Sites are numbered like the links in `Configuration`, the time index runs slowest.
+  For every direction there is one contiguous array over the sites, such that SIMD
+  kernels can load the indices for consecutive sites at once. The arrays are padded
+  to a multiple of `padding` with index zero, which is always a valid site.
+
+  The tables only depend on the lattice extents and are shared between all fields
+  of the same size, use `get` to obtain them.
+  */
+class NeighborTable {
+  public:
+    /// Padding of the arrays, a multiple of the widest SIMD register.
+    static int constexpr padding = 8;
+
+    NeighborTable(int const length_space, int const length_time);
+
+    /**
+      Returns the shared table for the given lattice extents.
+      */
+    static std::shared_ptr<NeighborTable const> get(int const length_space,
+                                                    int const length_time);
+
+    /**
+      Site indices of the neighbors \f$ x + \hat\mu \f$.
+      */
+    int const *forward(int const mu) const {
+        return indices.data() + mu * padded_volume;
+    }
+
+    /**
+      Site indices of the neighbors \f$ x - \hat\mu \f$.
+      */
+    int const *backward(int const mu) const {
+        return indices.data() + (4 + mu) * padded_volume;
+    }
+
+    /**
+      Site indices of the neighbors \f$ x + \hat\mu - \hat\nu \f$.
+      */
+    int const *diagonal(int const mu, int const nu) const {
+        return indices.data() + (8 + 4 * mu + nu) * padded_volume;
+    }
+
+    int forward(int const site, int const mu) const { return forward(mu)[site]; }
+    int backward(int const site, int const mu) const { return backward(mu)[site]; }
+    int diagonal(int const site, int const mu, int const nu) const {
+        return diagonal(mu, nu)[site];
+    }
+
+    int get_volume() const { return volume; }
+    int get_padded_volume() const { return padded_volume; }
+
+  private:
+    int volume, padded_volume;
+
+    std::vector<int> indices;
+};
@@ -0,0 +1,113 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Helpers to run the lattice sweeps in an existing team of threads.
+///
+/// A sweep contains orphaned `omp for` loops over all sites. Called from within a
+/// parallel region, for instance the one that `md_evolution` keeps alive for a
+/// whole trajectory, it has to be called by all threads of the team which then
+/// share the work. Called from serial code, it opens a parallel region of its own.
+///
+/// Threads are bound to places with `proc_bind(close)`, the places themselves are
+/// chosen with `OMP_PLACES`, for instance `OMP_PLACES=cores`.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+  Runs `body` on all threads of the current team or of a new one.
+  */
+template <typename Body>
+void parallel_region(Body const &body) {
+#ifdef _OPENMP
+    if (!omp_in_parallel()) {
+#pragma omp parallel proc_bind(close)
+        body();
+        return;
+    }
+#endif
+    body();
+}
+
+/**
+  Combines one value per thread over the team with `op`, the result is returned on
+  every thread.
+
+  Must be called by all threads of the team. The values are combined in the order
+  of the thread numbers, such that the result does not depend on timing.
+  */
+template <typename Op>
+double team_reduce(double const partial, Op const &op) {
+#ifdef _OPENMP
+    if (!omp_in_parallel()) {
+        return partial;
+    }
+
+    // The vector lives on the stack of one thread, the others get its address.
+    std::vector<double> partials;
+    std::vector<double> *shared;
+#pragma omp single copyprivate(shared)
+    {
+        partials.resize(omp_get_num_threads());
+        shared = &partials;
+    }
+    (*shared)[omp_get_thread_num()] = partial;
+#pragma omp barrier
+    double const result =
+        std::accumulate(shared->begin() + 1, shared->end(), shared->front(), op);
+    // The owner may only leave once everybody has read the partial values.
+#pragma omp barrier
+    return result;
+#else
+    return partial;
+#endif
+}
+
+/**
+  Sums one value per thread over the team, the result is returned on every thread.
+  */
+inline double team_sum(double const partial) {
+    return team_reduce(partial, std::plus<double>());
+}
+
+/**
+  Maximum of one value per thread over the team, returned on every thread.
+  */
+inline double team_max(double const partial) {
+    return team_reduce(partial, [](double const a, double const b) {
+        return std::max(a, b);
+    });
+}
+
+/**
+  Runs `body(partial)` on all threads of the current team or of a new one and
+  returns the sum of the per-thread `partial` values.
+  */
+template <typename Body>
+double parallel_sum(Body const &body) {
+#ifdef _OPENMP
+    if (!omp_in_parallel()) {
+        double result = 0.0;
+#pragma omp parallel proc_bind(close)
+        {
+            double partial = 0.0;
+            body(partial);
+            double const sum = team_sum(partial);
+#pragma omp master
+            result = sum;
+        }
+        return result;
+    }
+#endif
+    double partial = 0.0;
+    body(partial);
+    return team_sum(partial);
+}
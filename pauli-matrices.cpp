@@ -2,6 +2,7 @@
 
 #include "pauli-matrices.hpp"
 
+#include "quaternion.hpp"
 #include "sanity-checks.hpp"
 
 PauliMatrices::PauliMatrices() : matrices(3) {
@@ -15,7 +16,7 @@ PauliMatrices::PauliMatrices() : matrices(3) {
 Matrix random_from_algebra(std::mt19937 &engine, std::normal_distribution<double> &dist) {
     std::vector<double> coefficients = {dist(engine), dist(engine), dist(engine)};
     PauliMatrices const &pauli_matrices = PauliMatrices::get_instance();
-    Matrix algebra_element;
+    Matrix algebra_element = Matrix::Zero();
     for (int i = 0; i < 3; ++i) {
         Matrix scaled_generator = coefficients[i] * pauli_matrices.get(i);
         algebra_element += scaled_generator;
@@ -27,8 +28,8 @@ Matrix random_from_algebra(std::mt19937 &engine, std::normal_distribution<double
 }
 
 Matrix group_from_algebra(Matrix const &algebra_element) {
-    Matrix const exponent = imag_unit * algebra_element;
-    Matrix const group_element = exponent.exp();
+    Quaternion const exponent = imag_unit * algebra_element;
+    Matrix const group_element = exp(exponent);
     assert(is_unitary(group_element));
     return group_element;
 }
@@ -22,7 +22,7 @@ class PauliMatrices {
   private:
     PauliMatrices();
 
-    std::vector<Matrix> matrices;
+    std::vector<Matrix, Eigen::aligned_allocator<Matrix>> matrices;
 };
 
 Matrix random_from_algebra(std::mt19937 &engine, std::normal_distribution<double> &dist);
@@ -0,0 +1,119 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "plaquette-force.hpp"
+
+#include "hybrid-monte-carlo.hpp"
+#include "parallel.hpp"
+
+#include <cassert>
+
+namespace {
+
+/**
+  Adds the contributions of the plaquette at `site` in the plane (μ, ν) to its
+  four links.
+
+  \returns Trace of the plaquette.
+  */
+double scatter_plaquette(int const site,
+                         int const mu,
+                         int const nu,
+                         Configuration const &links,
+                         Configuration &links_staples) {
+    NeighborTable const &neighbors = links.get_neighbors();
+    int const site_mu = neighbors.forward(site, mu);
+    int const site_nu = neighbors.forward(site, nu);
+
+    Quaternion const &link1 = links(site, mu);
+    Quaternion const &link2 = links(site_mu, nu);
+    Quaternion const &link3 = links(site_nu, mu);
+    Quaternion const &link4 = links(site, nu);
+
+    // P = U_1 U_2 U_3^† U_4^† = A B^†. Each link times its staple from this
+    // plaquette is P cyclically permuted to start with that link.
+    Quaternion const a = link1 * link2;
+    Quaternion const b = link4 * link3;
+    Quaternion const plaquette = a * b.adjoint();
+
+    links_staples(site, mu) += plaquette;
+    links_staples(site_mu, nu) += link2 * b.adjoint() * link1;
+    links_staples(site_nu, mu) += link3 * a.adjoint() * link4;
+    links_staples(site, nu) += plaquette.adjoint();
+
+    return plaquette.trace();
+}
+}  // namespace
+
+double get_links_staples(Configuration const &links, Configuration &links_staples) {
+    assert(links_staples.get_volume() == links.get_volume());
+
+    int const extents[4] = {
+        links.length_time, links.length_space, links.length_space, links.length_space};
+    int const strides[4] = {
+        extents[1] * extents[2] * extents[3], extents[2] * extents[3], extents[3], 1};
+
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int i = 0; i < links_staples.get_size(); ++i) {
+            links_staples[i] = Quaternion();
+        }
+    });
+
+    // The links of a plaquette in the plane (μ, ν) share both coordinates
+    // perpendicular to it, so the plaquettes are distributed over the pairs of
+    // those. A plane and its complement have no direction in common and write
+    // disjoint links, they form one sweep. The three pairs of planes need a
+    // barrier between them because they write links of the same directions.
+    int const pairs[3][2][2] = {
+        {{0, 1}, {2, 3}}, {{0, 2}, {1, 3}}, {{0, 3}, {1, 2}}};
+
+    double plaquette_trace_sum = 0.0;
+    for (auto const &pair : pairs) {
+        // In each plane of the pair the perpendicular directions are those of the
+        // other plane.
+        int const counts[2] = {extents[pair[1][0]] * extents[pair[1][1]],
+                               extents[pair[0][0]] * extents[pair[0][1]]};
+
+        plaquette_trace_sum += parallel_sum([&](double &partial) {
+#pragma omp for schedule(static)
+            for (int i = 0; i < counts[0] + counts[1]; ++i) {
+                int const plane = i < counts[0] ? 0 : 1;
+                int const index = plane == 0 ? i : i - counts[0];
+                int const mu = pair[plane][0];
+                int const nu = pair[plane][1];
+                int const rho = pair[1 - plane][0];
+                int const sigma = pair[1 - plane][1];
+
+                int const base = index / extents[sigma] * strides[rho] +
+                                 index % extents[sigma] * strides[sigma];
+                // The plaquettes of the plane are walked in storage order.
+                for (int x_mu = 0; x_mu < extents[mu]; ++x_mu) {
+                    int const row = base + x_mu * strides[mu];
+                    for (int x_nu = 0; x_nu < extents[nu]; ++x_nu) {
+                        partial += scatter_plaquette(
+                            row + x_nu * strides[nu], mu, nu, links, links_staples);
+                    }
+                }
+            }
+        });
+    }
+
+    return plaquette_trace_sum;
+}
+
+double md_momentum_step(Configuration const &links,
+                        Configuration &links_staples,
+                        MomentumConfiguration &momenta,
+                        double const time_step,
+                        double const beta) {
+    double const plaquette_trace_sum = get_links_staples(links, links_staples);
+
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int i = 0; i < momenta.get_size(); ++i) {
+            momenta[i] += time_step * get_momentum_derivative(links_staples[i], beta);
+        }
+    });
+
+    return plaquette_trace_sum;
+}
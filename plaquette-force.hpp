@@ -0,0 +1,34 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include "configuration.hpp"
+
+/**
+  Computes the product of every link with its staples by walking the plaquettes.
+
+  Each plaquette is formed once and its contribution is scattered to its four
+  links, instead of building it again in the staples of every one of them. For a
+  plane (μ, ν) all links touched by a plaquette share the coordinates of the two
+  other directions, so the plaquettes are distributed over threads by the pairs of
+  those and no two threads write the same link. A plane is swept together with the
+  complementary one, which makes three sweeps.
+
+  \returns Plaquette trace sum of the links.
+  */
+double get_links_staples(Configuration const &links, Configuration &links_staples);
+
+/**
+  Momentum update like `md_momentum_step`, but with the plaquette-centric kernel.
+
+  `links_staples` is a scratch field of the same size as the links.
+
+  \returns Plaquette trace sum of the links.
+  */
+double md_momentum_step(Configuration const &links,
+                        Configuration &links_staples,
+                        MomentumConfiguration &momenta,
+                        double const time_step,
+                        double const beta);
@@ -1,18 +1,18 @@
 // Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
 
-#include "hybrid-monte-carlo.hpp"
-#include "pauli-matrices.hpp"
+#include "gauge-file.hpp"
+#include "quaternion.hpp"
 
 #include <cmath>
 #include <iostream>
+#include <stdexcept>
 
-int get_color(Matrix const &link, int const index) {
-    PauliMatrices const &pauli_matrices = PauliMatrices::get_instance();
+int get_color(Quaternion const &link, int const index) {
     double const pi = std::acos(-1);
 
-    Matrix const algebra = link.log();
-    auto const trace = (algebra * pauli_matrices.get(index)).trace();
-    auto const real = trace.imag();
+    // The logarithm is i θ n·σ, the trace with σ_index has imaginary part 2 θ n_index.
+    Quaternion const algebra = log(link);
+    auto const real = 2 * algebra[index + 1];
     auto const abs = std::abs(real);
 
     auto const result = abs / (2 * pi) * 255;
@@ -21,25 +21,42 @@ int get_color(Matrix const &link, int const index) {
     return result;
 }
 
+template <typename Links>
+Quaternion get_plaquette(Links const &links, int const site, int const mu, int const nu) {
+    NeighborTable const &neighbors = links.get_neighbors();
+    return links(site, mu) * links(neighbors.forward(site, mu), nu) *
+           links(neighbors.forward(site, nu), mu).adjoint() * links(site, nu).adjoint();
+}
+
+template <typename Links>
+void print_spatial_plaquettes(Links const &links) {
+    // The sites are in the order of the coordinates n1, n2, n3, n4.
+    for (int site = 0; site < links.get_volume(); ++site) {
+        double sum = 0.0;
+        for (int mu = 1; mu < 4; ++mu) {
+            for (int nu = 1; nu < 4; ++nu) {
+                sum += get_plaquette(links, site, mu, nu).trace();
+            }
+        }
+        std::cout << sum << "\t";
+    }
+    std::cout << "\n";
+}
+
 int main(int argc, char **argv) {
-    Configuration links(8, 8);
-    links.load(argv[1]);
-
-    for (int n1 = 0; n1 < links.length_time; ++n1) {
-        for (int n2 = 0; n2 < links.length_space; ++n2) {
-            for (int n3 = 0; n3 < links.length_space; ++n3) {
-                for (int n4 = 0; n4 < links.length_space; ++n4) {
-                    double sum = 0.0;
-                    for (int mu = 1; mu < 4; ++mu) {
-                        for (int nu = 1; nu < 4; ++nu) {
-                            sum += get_plaquette(n1, n2, n3, n4, mu, nu, links)
-                                       .trace()
-                                       .real();
-                        }
-                    }
-                    std::cout << sum << "\t";
-                }
+    // Uncompressed files are mapped into memory, nothing is copied. Compressed ones
+    // have to be decoded. The extents come from the header of each file. One line
+    // is printed per file.
+    for (int i = 1; i < argc; ++i) {
+        try {
+            if (read_gauge_file_header(argv[i]).codec == GaugeCodec::quaternion_double) {
+                print_spatial_plaquettes(MappedGaugeFile(argv[i]));
+            } else {
+                print_spatial_plaquettes(load_gauge_file(argv[i]));
             }
+        } catch (std::runtime_error const &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
         }
     }
 
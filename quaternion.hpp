@@ -0,0 +1,205 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include "matrix.hpp"
+
+#include <cmath>
+#include <ostream>
+
+/**
+  Compact representation of a real quaternion \f$ a_0 + i \vec a \cdot \vec \sigma
+  \f$.
+
+  Every SU(2) matrix can be written in this form with \f$ a_0^2 + \vec a^2 = 1 \f$.
+  Sums of SU(2) matrices (like the staples) stay in this form, they just lose the
+  unit norm. Only four real numbers are stored instead of the eight that a full
+  `Matrix` needs.
+
+  The real type is a template parameter, such that the molecular dynamics can run
+  in single precision. Conversions to and from `Matrix` always go through double.
+  */
+template <typename Real>
+class BasicQuaternion {
+  public:
+    using real_type = Real;
+
+    BasicQuaternion() : data{0, 0, 0, 0} {}
+
+    BasicQuaternion(Real const a0, Real const a1, Real const a2, Real const a3)
+        : data{a0, a1, a2, a3} {}
+
+    /**
+      Converts from a quaternion of another precision.
+      */
+    template <typename Other>
+    explicit BasicQuaternion(BasicQuaternion<Other> const &other)
+        : data{static_cast<Real>(other[0]), static_cast<Real>(other[1]),
+               static_cast<Real>(other[2]), static_cast<Real>(other[3])} {}
+
+    /**
+      Projects a 2×2 complex matrix onto the real quaternions.
+
+      For an element of SU(2) this is exact.
+      */
+    template <typename Derived>
+    BasicQuaternion(Eigen::MatrixBase<Derived> const &mat) {
+        Matrix const m = mat;
+        data[0] = 0.5 * (m(0, 0).real() + m(1, 1).real());
+        data[1] = 0.5 * (m(0, 1).imag() + m(1, 0).imag());
+        data[2] = 0.5 * (m(0, 1).real() - m(1, 0).real());
+        data[3] = 0.5 * (m(0, 0).imag() - m(1, 1).imag());
+    }
+
+    static BasicQuaternion identity() { return BasicQuaternion(1, 0, 0, 0); }
+
+    Real &operator[](int const i) { return data[i]; }
+    Real const &operator[](int const i) const { return data[i]; }
+
+    Matrix to_matrix() const {
+        Matrix m;
+        m << Complex{data[0], data[3]}, Complex{data[2], data[1]},
+            Complex{-data[2], data[1]}, Complex{data[0], -data[3]};
+        return m;
+    }
+
+    operator Matrix() const { return to_matrix(); }
+
+    BasicQuaternion adjoint() const {
+        return BasicQuaternion(data[0], -data[1], -data[2], -data[3]);
+    }
+
+    /**
+      Trace of the 2×2 matrix, which is always real for a quaternion.
+      */
+    Real trace() const { return 2 * data[0]; }
+
+    /**
+      Determinant of the 2×2 matrix, the squared quaternion norm.
+      */
+    Real determinant() const {
+        return data[0] * data[0] + data[1] * data[1] + data[2] * data[2] +
+               data[3] * data[3];
+    }
+
+    BasicQuaternion &operator+=(BasicQuaternion const &other) {
+        for (int i = 0; i < 4; ++i) {
+            data[i] += other.data[i];
+        }
+        return *this;
+    }
+
+    BasicQuaternion &operator-=(BasicQuaternion const &other) {
+        for (int i = 0; i < 4; ++i) {
+            data[i] -= other.data[i];
+        }
+        return *this;
+    }
+
+    BasicQuaternion &operator*=(Real const factor) {
+        for (int i = 0; i < 4; ++i) {
+            data[i] *= factor;
+        }
+        return *this;
+    }
+
+  private:
+    Real data[4];
+};
+
+/**
+  Quaternion for the gauge links.
+  */
+using Quaternion = BasicQuaternion<double>;
+
+/**
+  Quaternion for the links in the single precision molecular dynamics.
+  */
+using SingleQuaternion = BasicQuaternion<float>;
+
+template <typename Real>
+BasicQuaternion<Real> operator+(BasicQuaternion<Real> lhs,
+                                BasicQuaternion<Real> const &rhs) {
+    return lhs += rhs;
+}
+
+template <typename Real>
+BasicQuaternion<Real> operator-(BasicQuaternion<Real> lhs,
+                                BasicQuaternion<Real> const &rhs) {
+    return lhs -= rhs;
+}
+
+/// The factor is converted to the precision of the quaternion.
+template <typename Real>
+BasicQuaternion<Real> operator*(typename BasicQuaternion<Real>::real_type const factor,
+                                BasicQuaternion<Real> q) {
+    return q *= factor;
+}
+
+/**
+  Product of two quaternions, equivalent to the 2×2 matrix product.
+
+  With \f$ (a_0 + i \vec a \cdot \vec \sigma)(b_0 + i \vec b \cdot \vec \sigma) = a_0
+  b_0 - \vec a \cdot \vec b + i (a_0 \vec b + b_0 \vec a - \vec a \times \vec b) \cdot
+  \vec \sigma \f$ this needs 16 multiplications instead of the 32 complex ones.
+
+  It is inline because GCC otherwise calls it out of line in the staples, and a
+  single precision quaternion then goes through the stack in two halves.
+  */
+template <typename Real>
+inline BasicQuaternion<Real> operator*(BasicQuaternion<Real> const &a,
+                                       BasicQuaternion<Real> const &b) {
+    return BasicQuaternion<Real>(a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3],
+                      a[0] * b[1] + a[1] * b[0] - a[2] * b[3] + a[3] * b[2],
+                      a[0] * b[2] + a[2] * b[0] - a[3] * b[1] + a[1] * b[3],
+                      a[0] * b[3] + a[3] * b[0] - a[1] * b[2] + a[2] * b[1]);
+}
+
+template <typename Real>
+std::ostream &operator<<(std::ostream &os, BasicQuaternion<Real> const &q) {
+    return os << q.to_matrix();
+}
+
+/**
+  Exponential of a quaternion.
+
+  For a pure quaternion \f$ i \vec a \cdot \vec \sigma \f$ this is the SU(2) element
+  \f$ \cos|\vec a| + i \sin|\vec a| \, \hat a \cdot \vec \sigma \f$, so the generic
+  matrix exponential is not needed for the group from algebra mapping.
+  */
+template <typename Real>
+BasicQuaternion<Real> exp(BasicQuaternion<Real> const &q) {
+    Real const norm = std::sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    Real const scale = std::exp(q[0]);
+    // Use the Taylor expansion of sin(x)/x close to zero to avoid the division.
+    Real const sinc =
+        norm < Real(1e-4) ? 1 - norm * norm / 6 : std::sin(norm) / norm;
+    Real const factor = scale * sinc;
+    return BasicQuaternion<Real>(
+        scale * std::cos(norm), factor * q[1], factor * q[2], factor * q[3]);
+}
+
+/**
+  Logarithm of a quaternion, the inverse of `exp`.
+
+  For an SU(2) element the result is the pure quaternion \f$ i \theta \, \hat a \cdot
+  \vec \sigma \f$ with \f$ \theta \in [0, \pi] \f$.
+  */
+template <typename Real>
+BasicQuaternion<Real> log(BasicQuaternion<Real> const &q) {
+    Real const norm = std::sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    Real const angle = std::atan2(norm, q[0]);
+    Real const log_abs = std::log(q.determinant()) / 2;
+    if (norm == 0 && !(q[0] > 0)) {
+        // At minus the identity the direction is undefined, any axis with the
+        // angle π is valid.
+        return BasicQuaternion<Real>(log_abs, std::acos(Real(-1)), 0, 0);
+    }
+    // Close to the identity the ratio tends to 1/a0. Close to minus the identity
+    // the direction is still well defined.
+    Real const factor = norm < Real(1e-8) && q[0] > 0 ? 1 / q[0] : angle / norm;
+    return BasicQuaternion<Real>(
+        log_abs, factor * q[1], factor * q[2], factor * q[3]);
+}
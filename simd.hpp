@@ -0,0 +1,164 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+///
+/// Thin wrapper around the SIMD registers of the target architecture.
+///
+/// The widest instruction set that the compiler enables (we build with
+/// `-march=native`) is picked: AVX-512 with eight doubles per register, AVX2 with
+/// four, otherwise a plain `double` such that the kernels still compile everywhere.
+
+#pragma once
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+
+class DoubleVector {
+  public:
+    static int constexpr width = 8;
+
+    DoubleVector() = default;
+    explicit DoubleVector(double const value) : v(_mm512_set1_pd(value)) {}
+    DoubleVector(__m512d const v) : v(v) {}
+
+    static DoubleVector load(double const *const address) {
+        return _mm512_loadu_pd(address);
+    }
+
+    /**
+      Loads `width` doubles from `base` at the positions given by `indices`.
+      */
+    static DoubleVector gather(double const *const base, int const *const indices) {
+        __m256i const vindex =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(indices));
+        return _mm512_i32gather_pd(vindex, base, sizeof(double));
+    }
+
+    void store(double *const address) const { _mm512_storeu_pd(address, v); }
+
+    friend DoubleVector operator+(DoubleVector const a, DoubleVector const b) {
+        return _mm512_add_pd(a.v, b.v);
+    }
+    friend DoubleVector operator-(DoubleVector const a, DoubleVector const b) {
+        return _mm512_sub_pd(a.v, b.v);
+    }
+    friend DoubleVector operator*(DoubleVector const a, DoubleVector const b) {
+        return _mm512_mul_pd(a.v, b.v);
+    }
+
+    /// Computes `a * b + c`.
+    friend DoubleVector
+    fma(DoubleVector const a, DoubleVector const b, DoubleVector const c) {
+        return _mm512_fmadd_pd(a.v, b.v, c.v);
+    }
+
+    /// Computes `c - a * b`.
+    friend DoubleVector
+    fnma(DoubleVector const a, DoubleVector const b, DoubleVector const c) {
+        return _mm512_fnmadd_pd(a.v, b.v, c.v);
+    }
+
+  private:
+    __m512d v;
+};
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+class DoubleVector {
+  public:
+    static int constexpr width = 4;
+
+    DoubleVector() = default;
+    explicit DoubleVector(double const value) : v(_mm256_set1_pd(value)) {}
+    DoubleVector(__m256d const v) : v(v) {}
+
+    static DoubleVector load(double const *const address) {
+        return _mm256_loadu_pd(address);
+    }
+
+    /**
+      Loads `width` doubles from `base` at the positions given by `indices`.
+      */
+    static DoubleVector gather(double const *const base, int const *const indices) {
+        __m128i const vindex =
+            _mm_loadu_si128(reinterpret_cast<__m128i const *>(indices));
+        return _mm256_i32gather_pd(base, vindex, sizeof(double));
+    }
+
+    void store(double *const address) const { _mm256_storeu_pd(address, v); }
+
+    friend DoubleVector operator+(DoubleVector const a, DoubleVector const b) {
+        return _mm256_add_pd(a.v, b.v);
+    }
+    friend DoubleVector operator-(DoubleVector const a, DoubleVector const b) {
+        return _mm256_sub_pd(a.v, b.v);
+    }
+    friend DoubleVector operator*(DoubleVector const a, DoubleVector const b) {
+        return _mm256_mul_pd(a.v, b.v);
+    }
+
+    /// Computes `a * b + c`.
+    friend DoubleVector
+    fma(DoubleVector const a, DoubleVector const b, DoubleVector const c) {
+        return _mm256_fmadd_pd(a.v, b.v, c.v);
+    }
+
+    /// Computes `c - a * b`.
+    friend DoubleVector
+    fnma(DoubleVector const a, DoubleVector const b, DoubleVector const c) {
+        return _mm256_fnmadd_pd(a.v, b.v, c.v);
+    }
+
+  private:
+    __m256d v;
+};
+
+#else
+
+class DoubleVector {
+  public:
+    static int constexpr width = 1;
+
+    DoubleVector() = default;
+    explicit DoubleVector(double const value) : v(value) {}
+
+    static DoubleVector load(double const *const address) {
+        return DoubleVector(*address);
+    }
+
+    static DoubleVector gather(double const *const base, int const *const indices) {
+        return DoubleVector(base[*indices]);
+    }
+
+    void store(double *const address) const { *address = v; }
+
+    friend DoubleVector operator+(DoubleVector const a, DoubleVector const b) {
+        return DoubleVector(a.v + b.v);
+    }
+    friend DoubleVector operator-(DoubleVector const a, DoubleVector const b) {
+        return DoubleVector(a.v - b.v);
+    }
+    friend DoubleVector operator*(DoubleVector const a, DoubleVector const b) {
+        return DoubleVector(a.v * b.v);
+    }
+
+    /// Computes `a * b + c`.
+    friend DoubleVector
+    fma(DoubleVector const a, DoubleVector const b, DoubleVector const c) {
+        return DoubleVector(a.v * b.v + c.v);
+    }
+
+    /// Computes `c - a * b`.
+    friend DoubleVector
+    fnma(DoubleVector const a, DoubleVector const b, DoubleVector const c) {
+        return DoubleVector(c.v - a.v * b.v);
+    }
+
+  private:
+    double v;
+};
+
+#endif
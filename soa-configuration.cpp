@@ -0,0 +1,228 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "soa-configuration.hpp"
+
+#include "parallel.hpp"
+#include "sanity-checks.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+static_assert(NeighborTable::padding % DoubleVector::width == 0,
+              "The neighbor tables must be padded to a multiple of the SIMD width.");
+
+namespace {
+
+/**
+  `DoubleVector::width` quaternions, one per SIMD lane.
+  */
+struct QuaternionVector {
+    DoubleVector a[4];
+};
+
+QuaternionVector load(double const *const *const components, int const site) {
+    QuaternionVector q;
+    for (int c = 0; c < 4; ++c) {
+        q.a[c] = DoubleVector::load(components[c] + site);
+    }
+    return q;
+}
+
+QuaternionVector gather(double const *const *const components, int const *const sites) {
+    QuaternionVector q;
+    for (int c = 0; c < 4; ++c) {
+        q.a[c] = DoubleVector::gather(components[c], sites);
+    }
+    return q;
+}
+
+QuaternionVector adjoint(QuaternionVector const &q) {
+    DoubleVector const zero(0.0);
+    return {{q.a[0], zero - q.a[1], zero - q.a[2], zero - q.a[3]}};
+}
+
+/**
+  Lane-wise quaternion product, the same formula as for `Quaternion`.
+  */
+QuaternionVector operator*(QuaternionVector const &x, QuaternionVector const &y) {
+    DoubleVector const *const a = x.a;
+    DoubleVector const *const b = y.a;
+    return {{fnma(a[3], b[3], fnma(a[2], b[2], fnma(a[1], b[1], a[0] * b[0]))),
+             fma(a[3], b[2], fnma(a[2], b[3], fma(a[1], b[0], a[0] * b[1]))),
+             fma(a[1], b[3], fnma(a[3], b[1], fma(a[2], b[0], a[0] * b[2]))),
+             fma(a[2], b[1], fnma(a[1], b[2], fma(a[3], b[0], a[0] * b[3])))}};
+}
+
+QuaternionVector &operator+=(QuaternionVector &x, QuaternionVector const &y) {
+    for (int c = 0; c < 4; ++c) {
+        x.a[c] = x.a[c] + y.a[c];
+    }
+    return x;
+}
+
+/**
+  Applies the force to the links of direction `mu` of all sites.
+
+  The result for a link is `scale` times the momentum derivative, it is either
+  written to `output` or added to it.
+
+  \returns Sum of Re tr(U V) over the links of direction `mu`.
+  */
+double force_kernel(SoaConfiguration const &links,
+                    MomentumConfiguration &output,
+                    int const mu,
+                    double const beta,
+                    double const scale,
+                    bool const accumulate) {
+    int constexpr width = DoubleVector::width;
+
+    double const *component[4][4];
+    for (int nu = 0; nu < 4; ++nu) {
+        for (int c = 0; c < 4; ++c) {
+            component[nu][c] = links.component(nu, c);
+        }
+    }
+
+    NeighborTable const &neighbors = links.get_neighbors();
+
+    double const factor = -beta / static_cast<double>(number_of_colors) * scale;
+
+    return parallel_sum([&](double &links_staples_trace_sum) {
+#pragma omp for schedule(static)
+        for (int site = 0; site < links.get_volume(); site += width) {
+            QuaternionVector staples;
+            for (int c = 0; c < 4; ++c) {
+                staples.a[c] = DoubleVector(0.0);
+            }
+
+            for (int nu = 0; nu < 4; ++nu) {
+                if (nu == mu) {
+                    continue;
+                }
+
+                // Upper staple U_ν(x + μ) U_μ(x + ν)^† U_ν(x)^†.
+                QuaternionVector const link1 =
+                    gather(component[nu], neighbors.forward(mu) + site);
+                QuaternionVector const link2 =
+                    gather(component[mu], neighbors.forward(nu) + site);
+                QuaternionVector const link3 = load(component[nu], site);
+                staples += link1 * adjoint(link2) * adjoint(link3);
+
+                // Lower staple U_ν(x + μ - ν)^† U_μ(x - ν)^† U_ν(x - ν).
+                QuaternionVector const link4 =
+                    gather(component[nu], neighbors.diagonal(mu, nu) + site);
+                QuaternionVector const link5 =
+                    gather(component[mu], neighbors.backward(nu) + site);
+                QuaternionVector const link6 =
+                    gather(component[nu], neighbors.backward(nu) + site);
+                staples += adjoint(link4) * adjoint(link5) * link6;
+            }
+
+            QuaternionVector const links_staples = load(component[mu], site) * staples;
+
+            // Scatter the lanes back into the array-of-structures momenta.
+            double buffer[4][width];
+            links_staples.a[0].store(buffer[3]);
+            for (int c = 1; c < 4; ++c) {
+                (links_staples.a[c] * DoubleVector(factor)).store(buffer[c - 1]);
+            }
+            int const lanes = std::min(width, links.get_volume() - site);
+            for (int lane = 0; lane < lanes; ++lane) {
+                Algebra &target = output[4 * (site + lane) + mu];
+                for (int c = 0; c < 3; ++c) {
+                    target[c] =
+                        accumulate ? target[c] + buffer[c][lane] : buffer[c][lane];
+                }
+                links_staples_trace_sum += 2 * buffer[3][lane];
+            }
+        }
+    });
+}
+}  // namespace
+
+SoaConfiguration::SoaConfiguration(int const length_space, int const length_time)
+    : length_space(length_space),
+      length_time(length_time),
+      neighbors(NeighborTable::get(length_space, length_time)),
+      volume(neighbors->get_volume()),
+      padded_volume(neighbors->get_padded_volume()),
+      data(4 * 4 * padded_volume, 0.0) {}
+
+SoaConfiguration::SoaConfiguration(Configuration const &links)
+    : SoaConfiguration(links.length_space, links.length_time) {
+    assign(links);
+}
+
+void SoaConfiguration::assign(Configuration const &links) {
+    assert(links.get_volume() == volume);
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int site = 0; site < volume; ++site) {
+            for (int mu = 0; mu < 4; ++mu) {
+                Quaternion const &link = links[4 * site + mu];
+                for (int c = 0; c < 4; ++c) {
+                    component(mu, c)[site] = link[c];
+                }
+            }
+        }
+    });
+}
+
+void SoaConfiguration::extract(Configuration &links) const {
+    assert(links.get_volume() == volume);
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int site = 0; site < volume; ++site) {
+            for (int mu = 0; mu < 4; ++mu) {
+                Quaternion &link = links[4 * site + mu];
+                for (int c = 0; c < 4; ++c) {
+                    link[c] = component(mu, c)[site];
+                }
+            }
+        }
+    });
+}
+
+void compute_momentum_derivatives(SoaConfiguration const &links,
+                                  MomentumConfiguration &derivatives,
+                                  double const beta) {
+    for (int mu = 0; mu < 4; ++mu) {
+        force_kernel(links, derivatives, mu, beta, 1.0, false);
+    }
+}
+
+double md_momentum_step(SoaConfiguration const &links,
+                        MomentumConfiguration &momenta,
+                        double const time_step,
+                        double const beta) {
+    double links_staples_trace_sum = 0.0;
+    for (int mu = 0; mu < 4; ++mu) {
+        links_staples_trace_sum +=
+            force_kernel(links, momenta, mu, beta, time_step, true);
+    }
+    return links_staples_trace_sum / 4;
+}
+
+void md_link_step(SoaConfiguration const &links,
+                  SoaConfiguration &new_links,
+                  MomentumConfiguration const &momenta,
+                  double const time_step) {
+    assert(links.get_volume() == new_links.get_volume());
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int site = 0; site < links.get_volume(); ++site) {
+            for (int mu = 0; mu < 4; ++mu) {
+                Quaternion link;
+                for (int c = 0; c < 4; ++c) {
+                    link[c] = links.component(mu, c)[site];
+                }
+                Quaternion const new_link =
+                    exp(time_step * momenta(site, mu).times_imag_unit()) * link;
+                assert(is_unitary(new_link));
+                for (int c = 0; c < 4; ++c) {
+                    new_links.component(mu, c)[site] = new_link[c];
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,88 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include "configuration.hpp"
+#include "neighbor-table.hpp"
+#include "simd.hpp"
+
+#include <vector>
+
+/**
+  Gauge links in a structure-of-arrays layout.
+
+  For every direction μ and every quaternion component there is one contiguous array
+  over the sites, ordered like the sites in `Configuration`. A SIMD register can then
+  hold the same component of `DoubleVector::width` neighboring sites. The arrays are
+  padded to a multiple of the register width.
+  */
+class SoaConfiguration {
+  public:
+    SoaConfiguration(int const length_space, int const length_time);
+
+    explicit SoaConfiguration(Configuration const &links);
+
+    /**
+      Copies the links from the array-of-structures layout.
+      */
+    void assign(Configuration const &links);
+
+    /**
+      Copies the links back into the array-of-structures layout.
+      */
+    void extract(Configuration &links) const;
+
+    double const *component(int const mu, int const c) const {
+        return data.data() + (4 * mu + c) * padded_volume;
+    }
+
+    double *component(int const mu, int const c) {
+        return data.data() + (4 * mu + c) * padded_volume;
+    }
+
+    NeighborTable const &get_neighbors() const { return *neighbors; }
+
+    int length_space, length_time;
+
+    int get_volume() const { return volume; }
+    int get_padded_volume() const { return padded_volume; }
+
+  private:
+    std::shared_ptr<NeighborTable const> neighbors;
+
+    int volume, padded_volume;
+
+    std::vector<double> data;
+};
+
+/**
+  Computes the momentum derivative of all links with the SIMD kernel.
+
+  This is the vectorized equivalent of calling `compute_momentum_derivative` for
+  every link, `DoubleVector::width` sites are handled at once.
+  */
+void compute_momentum_derivatives(SoaConfiguration const &links,
+                                  MomentumConfiguration &derivatives,
+                                  double const beta);
+
+/**
+  Momentum update like `md_momentum_step` that uses the SIMD kernel.
+
+  \returns Plaquette trace sum of the links.
+  */
+double md_momentum_step(SoaConfiguration const &links,
+                        MomentumConfiguration &momenta,
+                        double const time_step,
+                        double const beta);
+
+/**
+  Link update like `md_link_step`, the links stay in the structure-of-arrays layout.
+
+  `links` and `new_links` may be the same, then the update is in place.
+  */
+void md_link_step(SoaConfiguration const &links,
+                  SoaConfiguration &new_links,
+                  MomentumConfiguration const &momenta,
+                  double const time_step);
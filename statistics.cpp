@@ -0,0 +1,376 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "statistics.hpp"
+
+#include "counter-rng.hpp"
+#include "parallel.hpp"
+
+#include <unsupported/Eigen/FFT>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+double get_mean(std::vector<double> const &data) {
+    return std::accumulate(data.begin(), data.end(), 0.0) / data.size();
+}
+
+/**
+  Squared error of the mean from the fluctuations around a straight line. A drift
+  would otherwise look like a long autocorrelation and hide itself in the error.
+  */
+double get_fluctuation_error(std::vector<double> const &data) {
+    int const size = data.size();
+    double const center = 0.5 * (size - 1);
+    double const mean = get_mean(data);
+    double covariance = 0.0;
+    double variance = 0.0;
+    for (int i = 0; i < size; ++i) {
+        covariance += (i - center) * (data[i] - mean);
+        variance += (i - center) * (i - center);
+    }
+    double const slope = covariance / variance;
+    std::vector<double> residuals(size);
+    for (int i = 0; i < size; ++i) {
+        residuals[i] = data[i] - mean - slope * (i - center);
+    }
+    double const error = gamma_method(residuals).error;
+    return error * error;
+}
+
+void require_bins(std::vector<double> const &bins) {
+    if (bins.size() < 2) {
+        throw std::invalid_argument("At least two bins are needed for an error.");
+    }
+}
+}  // namespace
+
+std::vector<double> get_autocovariance(std::vector<double> const &data,
+                                       int const max_lag) {
+    int const size = data.size();
+    int const lags = std::min(max_lag, size - 1) + 1;
+
+    // Padding to at least twice the length keeps the circular correlation from
+    // wrapping around. Powers of two are the fastest sizes.
+    int padded_size = 1;
+    while (padded_size < 2 * size) {
+        padded_size *= 2;
+    }
+    double const mean = get_mean(data);
+    std::vector<double> padded(padded_size, 0.0);
+    for (int i = 0; i < size; ++i) {
+        padded[i] = data[i] - mean;
+    }
+
+    Eigen::FFT<double> fft;
+    std::vector<std::complex<double>> spectrum;
+    fft.fwd(spectrum, padded);
+    for (auto &value : spectrum) {
+        value = std::norm(value);
+    }
+    std::vector<double> correlation;
+    fft.inv(correlation, spectrum);
+
+    std::vector<double> autocovariance(lags);
+    for (int t = 0; t < lags; ++t) {
+        autocovariance[t] = correlation[t] / (size - t);
+    }
+    return autocovariance;
+}
+
+GammaResult gamma_method(std::vector<double> const &data, double const s_tau) {
+    if (data.size() < 2) {
+        throw std::invalid_argument("The Γ-method needs at least two values.");
+    }
+    if (!(s_tau > 0)) {
+        throw std::invalid_argument("The windowing factor must be positive.");
+    }
+
+    int const size = data.size();
+    GammaResult result;
+    result.mean = get_mean(data);
+
+    std::vector<double> gamma = get_autocovariance(data, size / 2);
+    int const max_lag = gamma.size() - 1;
+    if (gamma[0] <= 0) {
+        // Constant data, there are no fluctuations.
+        result.error = 0.0;
+        result.tau_int = 0.5;
+        result.tau_int_error = 0.0;
+        result.window = 0;
+        result.rho = {1.0};
+        return result;
+    }
+
+    // Automatic windowing, Wolff (2004) eq. (52). Without a sign change of g the
+    // largest lag is used.
+    result.window = max_lag;
+    double tau_int = 0.5;
+    for (int w = 1; w <= max_lag; ++w) {
+        tau_int += gamma[w] / gamma[0];
+        double const tau =
+            tau_int > 0.5 ? s_tau / std::log((2 * tau_int + 1) / (2 * tau_int - 1))
+                          : 1e-6;
+        double const g = std::exp(-w / tau) - tau / std::sqrt(1.0 * w * size);
+        if (g < 0) {
+            result.window = w;
+            break;
+        }
+    }
+    int const window = result.window;
+
+    // The autocovariance is biased by the estimated mean, Wolff (2004) eq. (49).
+    double variance = gamma[0] + 2 * std::accumulate(gamma.begin() + 1,
+                                                     gamma.begin() + window + 1, 0.0);
+    for (auto &value : gamma) {
+        value += variance / size;
+    }
+    variance = gamma[0] +
+               2 * std::accumulate(gamma.begin() + 1, gamma.begin() + window + 1, 0.0);
+
+    result.error = std::sqrt(std::max(variance, 0.0) / size);
+    result.tau_int = variance / (2 * gamma[0]);
+    result.tau_int_error =
+        result.tau_int *
+        std::sqrt(std::max(4.0 * (window + 0.5 - result.tau_int) / size, 0.0));
+
+    int const rho_size = std::min(2 * window, max_lag) + 1;
+    result.rho.resize(rho_size);
+    for (int t = 0; t < rho_size; ++t) {
+        result.rho[t] = gamma[t] / gamma[0];
+    }
+    return result;
+}
+
+std::vector<double> get_bins(std::vector<double> const &data, int const bin_size) {
+    if (bin_size < 1) {
+        throw std::invalid_argument("The bin size must be positive.");
+    }
+    int const bin_count = data.size() / bin_size;
+    std::vector<double> bins(bin_count);
+    for (int bin = 0; bin < bin_count; ++bin) {
+        auto const begin = data.begin() + bin * bin_size;
+        bins[bin] = std::accumulate(begin, begin + bin_size, 0.0) / bin_size;
+    }
+    return bins;
+}
+
+ErrorEstimate binned_jackknife(std::vector<double> const &data, int const bin_size) {
+    std::vector<double> const bins = get_bins(data, bin_size);
+    require_bins(bins);
+
+    // The mean without bin i follows from the total sum in O(1).
+    int const count = bins.size();
+    double const sum = std::accumulate(bins.begin(), bins.end(), 0.0);
+    double const mean = sum / count;
+    double squares = 0.0;
+    for (double const bin : bins) {
+        double const deviation = (sum - bin) / (count - 1) - mean;
+        squares += deviation * deviation;
+    }
+    return {mean, std::sqrt((count - 1.0) / count * squares)};
+}
+
+ErrorEstimate binned_bootstrap(std::vector<double> const &data,
+                               int const bin_size,
+                               int const samples,
+                               std::uint32_t const seed) {
+    std::vector<double> const bins = get_bins(data, bin_size);
+    require_bins(bins);
+    if (samples < 2) {
+        throw std::invalid_argument("At least two bootstrap samples are needed.");
+    }
+
+    int const count = bins.size();
+    std::vector<double> means(samples);
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int sample = 0; sample < samples; ++sample) {
+            CounterRng const rng(seed, CounterRng::Purpose::bootstrap, sample);
+            double sum = 0.0;
+            double uniforms[4];
+            for (int i = 0; i < count; ++i) {
+                if (i % 4 == 0) {
+                    rng.uniforms(i / 4, uniforms);
+                }
+                int const drawn =
+                    std::min(count - 1, static_cast<int>(uniforms[i % 4] * count));
+                sum += bins[drawn];
+            }
+            means[sample] = sum / count;
+        }
+    });
+
+    double const mean = get_mean(means);
+    double squares = 0.0;
+    for (double const sample_mean : means) {
+        squares += (sample_mean - mean) * (sample_mean - mean);
+    }
+    return {get_mean(bins), std::sqrt(squares / (samples - 1))};
+}
+
+int constexpr BinningAnalysis::min_bins;
+
+void BinningAnalysis::add(double const value) {
+    // A completed pair is passed on as a value of the next level.
+    double carried = value;
+    for (int level = 0;; ++level) {
+        if (level == static_cast<int>(levels.size())) {
+            levels.push_back({0, 0.0, 0.0, 0.0, false});
+        }
+        Level &current = levels[level];
+        ++current.count;
+        double const delta = carried - current.mean;
+        current.mean += delta / current.count;
+        current.squares += delta * (carried - current.mean);
+        if (!current.has_pending) {
+            current.pending = carried;
+            current.has_pending = true;
+            return;
+        }
+        current.has_pending = false;
+        carried = 0.5 * (current.pending + carried);
+    }
+}
+
+int BinningAnalysis::get_levels() const {
+    int usable = 0;
+    while (usable < static_cast<int>(levels.size()) &&
+           levels[usable].count >= min_bins) {
+        ++usable;
+    }
+    return usable;
+}
+
+double BinningAnalysis::get_error(int const level) const {
+    if (level >= static_cast<int>(levels.size()) || levels[level].count < 2) {
+        return std::numeric_limits<double>::infinity();
+    }
+    long const count = levels[level].count;
+    return std::sqrt(levels[level].squares / (count - 1) / count);
+}
+
+double BinningAnalysis::get_error() const {
+    int const usable = get_levels();
+    if (usable == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double error = 0.0;
+    for (int level = 0; level < usable; ++level) {
+        error = std::max(error, get_error(level));
+    }
+    return error;
+}
+
+double BinningAnalysis::get_tau_int() const {
+    double const binned = get_error();
+    double const naive = get_error(0);
+    if (std::isinf(binned)) {
+        return binned;
+    }
+    if (naive == 0) {
+        return 0.5;
+    }
+    return 0.5 * (binned / naive) * (binned / naive);
+}
+
+void BinningAnalysis::save_state(std::ostream &os) const {
+    auto const precision = os.precision(std::numeric_limits<double>::max_digits10);
+    os << levels.size() << "\n";
+    for (auto const &level : levels) {
+        os << level.count << " " << level.mean << " " << level.squares << " "
+           << level.pending << " " << level.has_pending << "\n";
+    }
+    os.precision(precision);
+}
+
+void BinningAnalysis::load_state(std::istream &is) {
+    size_t size;
+    is >> size;
+    levels.resize(size);
+    for (auto &level : levels) {
+        is >> level.count >> level.mean >> level.squares >> level.pending >>
+            level.has_pending;
+    }
+}
+
+int constexpr OnlineAnalysis::first_check;
+
+void OnlineAnalysis::add(double const average_plaquette,
+                         double const energy_difference) {
+    ++count;
+    double const boltzmann_factor = std::exp(-energy_difference);
+    if (is_thermalized()) {
+        plaquette.add(average_plaquette);
+        boltzmann.add(boltzmann_factor);
+        return;
+    }
+    plaquette_history.push_back(average_plaquette);
+    boltzmann_history.push_back(boltzmann_factor);
+    if (count >= next_check) {
+        check_thermalization();
+    }
+}
+
+bool OnlineAnalysis::has_reached(double const target_error) const {
+    int const levels = plaquette.get_levels();
+    if (!is_thermalized() || levels == 0) {
+        return false;
+    }
+    double const bin_size = std::pow(2.0, levels - 1);
+    return plaquette.get_error() <= target_error &&
+           bin_size >= 4 * plaquette.get_tau_int();
+}
+
+void OnlineAnalysis::check_thermalization() {
+    int const cut = count / 2;
+    int const middle = cut + (count - cut) / 2;
+    auto const begin = plaquette_history.begin();
+    std::vector<double> const third(begin + cut, begin + middle);
+    std::vector<double> const fourth(begin + middle, plaquette_history.end());
+    double const error = std::sqrt(get_fluctuation_error(third) +
+                                   get_fluctuation_error(fourth));
+    if (std::abs(get_mean(third) - get_mean(fourth)) > 2 * error) {
+        // Still drifting, the tests get sparser such that their cost stays linear.
+        next_check = count + std::max(8, count / 32);
+        return;
+    }
+
+    thermalization = cut;
+    for (int i = cut; i < count; ++i) {
+        plaquette.add(plaquette_history[i]);
+        boltzmann.add(boltzmann_history[i]);
+    }
+    plaquette_history = std::vector<double>();
+    boltzmann_history = std::vector<double>();
+}
+
+void OnlineAnalysis::save_state(std::ostream &os) const {
+    auto const precision = os.precision(std::numeric_limits<double>::max_digits10);
+    os << count << " " << next_check << " " << thermalization << "\n";
+    os << plaquette_history.size() << "\n";
+    for (size_t i = 0; i < plaquette_history.size(); ++i) {
+        os << plaquette_history[i] << " " << boltzmann_history[i] << "\n";
+    }
+    os.precision(precision);
+    plaquette.save_state(os);
+    boltzmann.save_state(os);
+}
+
+void OnlineAnalysis::load_state(std::istream &is) {
+    is >> count >> next_check >> thermalization;
+    size_t size;
+    is >> size;
+    plaquette_history.resize(size);
+    boltzmann_history.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+        is >> plaquette_history[i] >> boltzmann_history[i];
+    }
+    plaquette.load_state(is);
+    boltzmann.load_state(is);
+}
@@ -0,0 +1,203 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Errors of Monte Carlo averages from autocorrelated time series.
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/**
+  Autocovariance \f$ \Gamma(t) = \frac1{N-t} \sum_{i=1}^{N-t} \delta_i \delta_{i+t}
+  \f$ of the fluctuations \f$ \delta_i = a_i - \bar a \f$ for \f$ t = 0, \ldots,
+  \f$ `max_lag`.
+
+  All lags are computed at once with a zero padded FFT in \f$ O(N \log N) \f$.
+  */
+std::vector<double> get_autocovariance(std::vector<double> const &data,
+                                       int const max_lag);
+
+/**
+  Mean of a time series with its error from the integrated autocorrelation time.
+  */
+struct GammaResult {
+    double mean;
+    double error;
+
+    /// Integrated autocorrelation time, 1/2 for uncorrelated data.
+    double tau_int;
+    double tau_int_error;
+
+    /// Summation window of the autocorrelation function.
+    int window;
+
+    /// Normalized autocorrelation function ρ(t) up to twice the window.
+    std::vector<double> rho;
+};
+
+/**
+  Γ-method with automatic windowing.
+
+  Wolff, “Monte Carlo errors with less errors”, Comput. Phys. Commun. 156 (2004)
+  143. The window W is the first one where the systematic error \f$
+  \exp(-W/\tau) \f$ of the truncated sum falls below the statistical error \f$
+  \sqrt{\tau/N} \f$, with \f$ \tau \f$ estimated from \f$ \tau_\text{int}(W) \f$
+  and the factor `s_tau`. The bias of the autocovariance from the estimated mean
+  is corrected.
+
+  \throws std::invalid_argument With fewer than two values or `s_tau` ≤ 0.
+  */
+GammaResult gamma_method(std::vector<double> const &data, double const s_tau = 1.5);
+
+/**
+  Averages of consecutive bins of `bin_size` values, the remainder at the end is
+  dropped.
+
+  \throws std::invalid_argument If the bin size is not positive.
+  */
+std::vector<double> get_bins(std::vector<double> const &data, int const bin_size);
+
+struct ErrorEstimate {
+    double mean;
+    double error;
+};
+
+/**
+  Jackknife error of the mean of bins of `bin_size` values.
+
+  \throws std::invalid_argument With fewer than two bins.
+  */
+ErrorEstimate binned_jackknife(std::vector<double> const &data, int const bin_size);
+
+/**
+  Bootstrap error of the mean of bins of `bin_size` values.
+
+  The samples are drawn in parallel. Each one has its own stream of the counter
+  based generator, the result does not depend on the number of threads.
+
+  \throws std::invalid_argument With fewer than two bins or samples.
+  */
+ErrorEstimate binned_bootstrap(std::vector<double> const &data,
+                               int const bin_size,
+                               int const samples,
+                               std::uint32_t const seed);
+
+/**
+  Streaming error of the mean with logarithmic binning.
+
+  Level k holds the means of bins of 2^k consecutive values, each level passes
+  pairs of its values on to the next one. Memory is logarithmic in the number of
+  values and adding one is O(1) amortized. For autocorrelated data the error of
+  the levels grows with the bin size until the bins are independent.
+  */
+class BinningAnalysis {
+  public:
+    /// Levels with fewer bins are too noisy for an error.
+    static int constexpr min_bins = 64;
+
+    void add(double const value);
+
+    long get_count() const { return levels.empty() ? 0 : levels[0].count; }
+
+    double get_mean() const { return levels.empty() ? 0.0 : levels[0].mean; }
+
+    /**
+      Number of levels that have at least `min_bins` bins.
+      */
+    int get_levels() const;
+
+    /**
+      Error of the mean from the bins of the given level, infinite with fewer than
+      two bins.
+      */
+    double get_error(int const level) const;
+
+    /**
+      Largest error of the levels with at least `min_bins` bins, which is where
+      the errors level off. Infinite without such a level.
+      */
+    double get_error() const;
+
+    /**
+      Integrated autocorrelation time from the ratio of the binned to the naive
+      error.
+      */
+    double get_tau_int() const;
+
+    void save_state(std::ostream &os) const;
+    void load_state(std::istream &is);
+
+  private:
+    struct Level {
+        long count;
+        double mean;
+        /// Sum of the squared deviations from the mean, updated after Welford.
+        double squares;
+        /// First value of the pair that is not complete yet.
+        double pending;
+        bool has_pending;
+    };
+
+    std::vector<Level> levels;
+};
+
+/**
+  Online analysis of the chain: detects the end of the thermalization and then
+  estimates the errors of the plaquette and of exp(−ΔH).
+
+  Until the chain is thermalized the history is kept. At geometrically spaced
+  trajectories n the third and fourth quarter of it are compared, if their means
+  agree within twice the combined error, the first half is taken as
+  thermalization. The errors come from the Γ-method on the fluctuations around a
+  straight line through each quarter, such that a drift does not enlarge them.
+  The rest of the history is then passed to the binning and discarded.
+  */
+class OnlineAnalysis {
+  public:
+    /// Trajectories before the first test, each quarter has a quarter of them.
+    static int constexpr first_check = 128;
+
+    OnlineAnalysis() : count(0), next_check(first_check), thermalization(-1) {}
+
+    void add(double const average_plaquette, double const energy_difference);
+
+    bool is_thermalized() const { return thermalization >= 0; }
+
+    /**
+      Number of trajectories that are discarded as thermalization, -1 before it
+      has been detected.
+      */
+    int get_thermalization() const { return thermalization; }
+
+    /// Plaquette after the thermalization.
+    BinningAnalysis const &get_plaquette() const { return plaquette; }
+
+    /// exp(−ΔH) after the thermalization, its mean has to be one.
+    BinningAnalysis const &get_boltzmann() const { return boltzmann; }
+
+    /**
+      Whether the chain is thermalized and the error of the plaquette is at most
+      `target_error`. The bins of the error have to be at least four times the
+      autocorrelation time, otherwise the error may not have leveled off yet.
+      */
+    bool has_reached(double const target_error) const;
+
+    void save_state(std::ostream &os) const;
+    void load_state(std::istream &is);
+
+  private:
+    void check_thermalization();
+
+    int count;
+    int next_check;
+    int thermalization;
+
+    std::vector<double> plaquette_history;
+    std::vector<double> boltzmann_history;
+
+    BinningAnalysis plaquette;
+    BinningAnalysis boltzmann;
+};
@@ -0,0 +1,108 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "step-size-tuner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+/// Parameters γ, t_0 and κ of the dual averaging as recommended by Hoffman and
+/// Gelman.
+double const shrinkage = 0.05;
+double const iteration_offset = 10;
+double const average_exponent = 0.75;
+
+/// The step size stays within this factor of the initial one.
+double const max_change = 10;
+}  // namespace
+
+StepSizeTuner::StepSizeTuner(double const time_step,
+                             int const steps,
+                             double const target_acceptance,
+                             bool const fixed_length)
+    : target_acceptance(target_acceptance),
+      fixed_length(fixed_length),
+      length(time_step * steps),
+      count(0),
+      acceptance_sum(0.0),
+      error_average(0.0),
+      log_step_average(std::log(time_step)),
+      frozen(false),
+      time_step(time_step),
+      steps(steps) {
+    if (!(target_acceptance > 0 && target_acceptance < 1)) {
+        throw std::invalid_argument("The target acceptance has to be between 0 and 1.");
+    }
+    if (!(time_step > 0) || steps < 1) {
+        throw std::invalid_argument(
+            "The step size and the number of steps have to be positive.");
+    }
+
+    // Larger than the initial step, such that a too small one grows quickly.
+    shrinkage_target = std::log(2 * time_step);
+
+    // A few rejections at the start would otherwise shrink the step geometrically,
+    // in the mode with fixed length the number of steps would explode.
+    min_log_step = std::log(time_step / max_change);
+    max_log_step = std::log(time_step * max_change);
+}
+
+void StepSizeTuner::update(double const energy_difference) {
+    if (frozen) {
+        return;
+    }
+
+    // A trajectory with a non-finite energy difference is never accepted.
+    double const acceptance = std::isnan(energy_difference)
+                                  ? 0.0
+                                  : std::min(1.0, std::exp(-energy_difference));
+    ++count;
+    acceptance_sum += acceptance;
+
+    double const weight = 1 / (count + iteration_offset);
+    error_average =
+        (1 - weight) * error_average + weight * (target_acceptance - acceptance);
+    double const unbounded_log_step =
+        shrinkage_target - std::sqrt(count) / shrinkage * error_average;
+    double const log_step =
+        std::min(max_log_step, std::max(min_log_step, unbounded_log_step));
+    double const average_weight = std::pow(count, -average_exponent);
+    log_step_average =
+        average_weight * log_step + (1 - average_weight) * log_step_average;
+    set_parameters(log_step);
+}
+
+void StepSizeTuner::freeze() {
+    frozen = true;
+    set_parameters(log_step_average);
+}
+
+void StepSizeTuner::set_parameters(double const log_step) {
+    if (fixed_length) {
+        double const wanted = length / std::exp(log_step);
+        steps = wanted < std::numeric_limits<int>::max()
+                    ? std::max(1, static_cast<int>(std::lround(wanted)))
+                    : std::numeric_limits<int>::max();
+        time_step = length / steps;
+    } else {
+        time_step = std::exp(log_step);
+    }
+}
+
+void StepSizeTuner::save_state(std::ostream &os) const {
+    auto const precision = os.precision(std::numeric_limits<double>::max_digits10);
+    os << count << " " << acceptance_sum << " " << error_average << " "
+       << log_step_average << " " << frozen << " " << time_step << " " << steps
+       << "\n";
+    os.precision(precision);
+}
+
+void StepSizeTuner::load_state(std::istream &is) {
+    is >> count >> acceptance_sum >> error_average >> log_step_average >> frozen >>
+        time_step >> steps;
+}
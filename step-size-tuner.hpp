@@ -0,0 +1,90 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+
+#pragma once
+
+#include <iosfwd>
+
+/**
+  Tunes the step size of the molecular dynamics towards a target acceptance.
+
+  The dual averaging of Hoffman and Gelman, “The No-U-Turn Sampler”, JMLR 15
+  (2014) 1593, Algorithm 5, works on the logarithm of the step size with the
+  acceptance probability \f$ \min(1, \exp(-\Delta H)) \f$ of every trajectory.
+  The steps used during the tuning jump around the optimum, their running
+  average converges to it and is used once the tuning is frozen.
+
+  The step size is kept within a factor of ten of the initial one, such that
+  early rejections cannot make the trajectories arbitrarily expensive.
+
+  Changing the step size breaks detailed balance, the trajectories of the tuning
+  belong to the thermalization.
+  */
+class StepSizeTuner {
+  public:
+    /**
+      \param time_step Initial step size.
+      \param steps Number of steps per trajectory.
+      \param target_acceptance Mean acceptance probability to aim at.
+      \param fixed_length Keep the trajectory length `time_step * steps` and tune
+      the number of steps instead, the step size is then the length divided by
+      them.
+
+      \throws std::invalid_argument if the target is not between 0 and 1 or the
+      step size or the number of steps is not positive.
+      */
+    StepSizeTuner(double const time_step,
+                  int const steps,
+                  double const target_acceptance,
+                  bool const fixed_length);
+
+    /**
+      Adapts the parameters to the energy difference of a trajectory that used the
+      current ones. Does nothing once frozen.
+      */
+    void update(double const energy_difference);
+
+    /**
+      Ends the tuning with the averaged step size.
+      */
+    void freeze();
+
+    bool is_frozen() const { return frozen; }
+
+    double get_time_step() const { return time_step; }
+
+    int get_steps() const { return steps; }
+
+    /// Number of trajectories used for the tuning.
+    int get_count() const { return count; }
+
+    /// Mean acceptance probability of the trajectories used for the tuning.
+    double get_acceptance() const { return acceptance_sum / count; }
+
+    void save_state(std::ostream &os) const;
+    void load_state(std::istream &is);
+
+  private:
+    void set_parameters(double const log_step);
+
+    double target_acceptance;
+    bool fixed_length;
+    double length;
+
+    /// The iterates are shrunk towards this value.
+    double shrinkage_target;
+
+    /// Range of the logarithm of the step size.
+    double min_log_step;
+    double max_log_step;
+
+    int count;
+    double acceptance_sum;
+    double error_average;
+    double log_step_average;
+    bool frozen;
+
+    double time_step;
+    int steps;
+};
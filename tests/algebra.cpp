@@ -0,0 +1,47 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../algebra.hpp"
+#include "../pauli-matrices.hpp"
+#include "../sanity-checks.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+TEST(algebra, roundTrip) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (int i = 0; i < 10; ++i) {
+        Matrix const mat = random_from_algebra(engine, dist);
+        Algebra const a(mat);
+        ASSERT_TRUE(is_equal(mat, a.to_matrix())) << "Happened at i = " << i << "\n"
+                                                  << mat << "\n"
+                                                  << a;
+        ASSERT_TRUE(is_hermitian(a));
+        ASSERT_TRUE(is_traceless(a));
+    }
+}
+
+TEST(algebra, normSquared) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (int i = 0; i < 10; ++i) {
+        Matrix const mat = random_from_algebra(engine, dist);
+        Algebra const a(mat);
+        ASSERT_NEAR(0.5 * (mat * mat).trace().real(), a.norm_squared(), 1e-10);
+    }
+}
+
+TEST(algebra, timesImagUnit) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (int i = 0; i < 10; ++i) {
+        Matrix const mat = random_from_algebra(engine, dist);
+        Algebra const a(mat);
+        Matrix const expected = imag_unit * mat;
+        ASSERT_TRUE(is_equal(expected, a.times_imag_unit()));
+    }
+}
@@ -0,0 +1,72 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../async-writer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST(asyncWriter, keepsOrder) {
+    std::vector<int> written;
+    {
+        AsyncWriter writer(2);
+        for (int i = 0; i < 100; ++i) {
+            writer.submit([&written, i]() { written.push_back(i); });
+        }
+        writer.wait();
+        ASSERT_EQ(written.size(), 100);
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(written[i], i);
+        }
+
+        // The destructor finishes the outstanding jobs.
+        writer.submit([&written]() { written.push_back(100); });
+    }
+    EXPECT_EQ(written.size(), 101);
+}
+
+TEST(asyncWriter, boundedQueue) {
+    std::atomic<bool> release(false);
+    std::atomic<int> done(0);
+    AsyncWriter writer(1);
+
+    // The first job blocks the thread, the second one fills the queue.
+    writer.submit([&]() {
+        while (!release) {
+        }
+        ++done;
+    });
+    writer.submit([&]() { ++done; });
+
+    std::thread producer([&]() { writer.submit([&]() { ++done; }); });
+    EXPECT_EQ(done, 0);
+    release = true;
+    producer.join();
+    writer.wait();
+    EXPECT_EQ(done, 3);
+}
+
+TEST(asyncWriter, forwardsErrors) {
+    std::atomic<bool> release(false);
+    AsyncWriter writer(4);
+    bool dropped = true;
+    writer.submit([&release]() {
+        while (!release) {
+        }
+        throw std::runtime_error("disk full");
+    });
+    writer.submit([&dropped]() { dropped = false; });
+    release = true;
+    EXPECT_THROW(writer.wait(), std::runtime_error);
+    EXPECT_TRUE(dropped);
+
+    // The error is reported once, afterwards the writer works again.
+    bool written = false;
+    writer.submit([&written]() { written = true; });
+    writer.wait();
+    EXPECT_TRUE(written);
+
+    EXPECT_THROW(AsyncWriter(0), std::invalid_argument);
+}
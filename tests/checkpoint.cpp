@@ -0,0 +1,94 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../checkpoint.hpp"
+#include "../heatbath.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+TEST(checkpoint, roundTrip) {
+    std::string const path = "test-checkpoint.bin";
+
+    Configuration const links = make_hot_start(4, 6, 1, 0);
+    ChainState state;
+    state.number_computed = 17;
+    state.number_accepted = 12;
+    state.number_stored = 3;
+    state.finished = true;
+    state.parameters = {{"md.beta", "2.2999999999999998"}, {"md.integrator", "omf4"}};
+    state.engine.discard(100);
+    state.uniform(state.engine);
+    state.analysis_state = "opaque\nstate with\nlines";
+    state.tuning_state = "4 5\n";
+    state.output_sizes["plaquette.tsv"] = 1234;
+    state.output_sizes["accept.tsv"] = 56;
+    state.measured_trajectories["measurement-plaquette.tsv"] = 15;
+
+    save_checkpoint(path, state, links);
+
+    Configuration loaded_links(4, 6);
+    ChainState loaded;
+    load_checkpoint(path, loaded, loaded_links);
+
+    EXPECT_EQ(loaded.number_computed, 17);
+    EXPECT_EQ(loaded.number_accepted, 12);
+    EXPECT_EQ(loaded.number_stored, 3);
+    EXPECT_TRUE(loaded.finished);
+    EXPECT_EQ(loaded.parameters, state.parameters);
+    EXPECT_EQ(loaded.analysis_state, state.analysis_state);
+    EXPECT_EQ(loaded.tuning_state, state.tuning_state);
+    EXPECT_EQ(loaded.output_sizes, state.output_sizes);
+    EXPECT_EQ(loaded.measured_trajectories, state.measured_trajectories);
+
+    // The random stream continues where it was saved.
+    EXPECT_EQ(loaded.uniform(loaded.engine), state.uniform(state.engine));
+
+    for (int i = 0; i < links.get_size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            ASSERT_EQ(loaded_links[i][c], links[i][c]);
+        }
+    }
+
+    Configuration wrong_extents(4, 4);
+    EXPECT_THROW(load_checkpoint(path, loaded, wrong_extents), std::runtime_error);
+
+    std::remove(path.c_str());
+    EXPECT_THROW(load_checkpoint(path, loaded, loaded_links), std::runtime_error);
+}
+
+TEST(checkpoint, parameters) {
+    ChainParameters const recorded = {{"md.beta", "2.3"}, {"md.steps", "10"}};
+    EXPECT_NO_THROW(check_parameters(recorded, recorded));
+
+    ChainParameters other_beta = recorded;
+    other_beta["md.beta"] = "2.4";
+    EXPECT_THROW(check_parameters(recorded, other_beta), std::runtime_error);
+
+    ChainParameters more = recorded;
+    more["md.layout"] = "soa";
+    EXPECT_THROW(check_parameters(recorded, more), std::runtime_error);
+    EXPECT_THROW(check_parameters(more, recorded), std::runtime_error);
+}
+
+TEST(checkpoint, heatbathResume) {
+    // The heatbath has no state besides the links, a new instance continues with
+    // the next sweep exactly like the old one.
+    Configuration links = make_hot_start(4, 4, 1, 0);
+    Heatbath heatbath(4, 4, 0);
+    heatbath.update(links, 2.3, 1, 0);
+
+    Configuration continued = links;
+    heatbath.update(links, 2.3, 1, 1);
+
+    Heatbath restored(4, 4, 0);
+    restored.update(continued, 2.3, 1, 1);
+
+    for (int i = 0; i < links.get_size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            ASSERT_EQ(continued[i][c], links[i][c]);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../configuration.hpp"
+#include "../counter-rng.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+/**
+  Generator with the raw Philox key, for the known answers of the reference
+  implementation.
+  */
+CounterRng make_raw(std::uint32_t const key0,
+                    std::uint32_t const key1,
+                    std::uint64_t const stream) {
+    return CounterRng(key0, static_cast<CounterRng::Purpose>(key1), stream);
+}
+}
+
+TEST(counterRng, knownAnswers) {
+    std::uint32_t out[4];
+
+    make_raw(0, 0, 0).generate(0, out);
+    EXPECT_EQ(out[0], 0x6627e8d5u);
+    EXPECT_EQ(out[1], 0xe169c58du);
+    EXPECT_EQ(out[2], 0xbc57ac4cu);
+    EXPECT_EQ(out[3], 0x9b00dbd8u);
+
+    make_raw(0xffffffff, 0xffffffff, 0xffffffffffffffff).generate(0xffffffffffffffff, out);
+    EXPECT_EQ(out[0], 0x408f276du);
+    EXPECT_EQ(out[1], 0x41c83b0eu);
+    EXPECT_EQ(out[2], 0xa20bc7c6u);
+    EXPECT_EQ(out[3], 0x6d5451fdu);
+
+    make_raw(0xa4093822, 0x299f31d0, 0x0370734413198a2e).generate(0x85a308d3243f6a88, out);
+    EXPECT_EQ(out[0], 0xd16cfe09u);
+    EXPECT_EQ(out[1], 0x94fdccebu);
+    EXPECT_EQ(out[2], 0x5001e420u);
+    EXPECT_EQ(out[3], 0x24126ea1u);
+}
+
+TEST(counterRng, gaussianMoments) {
+    CounterRng const rng(1, CounterRng::Purpose::momenta, 0);
+    int const count = 50000;
+    std::vector<double> normals(4 * count);
+    rng.fill_gaussians(0, count, normals.data());
+
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    for (double const x : normals) {
+        sum += x;
+        sum_squares += x * x;
+    }
+    EXPECT_NEAR(sum / normals.size(), 0.0, 0.01);
+    EXPECT_NEAR(sum_squares / normals.size(), 1.0, 0.01);
+}
+
+TEST(counterRng, batchesMatchSingleIndices) {
+    CounterRng const rng(3, CounterRng::Purpose::momenta, 7);
+    double batch[4 * 10];
+    rng.fill_gaussians(100, 10, batch);
+    for (int i = 0; i < 10; ++i) {
+        double single[4];
+        rng.fill_gaussians(100 + i, 1, single);
+        for (int j = 0; j < 4; ++j) {
+            ASSERT_EQ(batch[4 * i + j], single[j]);
+        }
+    }
+}
+
+TEST(counterRng, momentaDependOnlyOnKey) {
+    MomentumConfiguration momenta(4, 4);
+    randomize_algebra(momenta, CounterRng(3, CounterRng::Purpose::momenta, 7), 0.5);
+
+    // Every link has the first three numbers of its own index.
+    for (int i = 0; i < momenta.get_size(); ++i) {
+        double normals[4];
+        CounterRng(3, CounterRng::Purpose::momenta, 7).fill_gaussians(i, 1, normals);
+        for (int j = 0; j < 3; ++j) {
+            ASSERT_EQ(momenta[i][j], 0.5 * normals[j]);
+        }
+    }
+
+    MomentumConfiguration other(4, 4);
+    randomize_algebra(other, CounterRng(3, CounterRng::Purpose::momenta, 8), 0.5);
+    ASSERT_NE(momenta[0][0], other[0][0]);
+}
@@ -0,0 +1,141 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../gauge-file.hpp"
+#include "../hybrid-monte-carlo.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+TEST(gaugeFile, roundTrip) {
+    std::string const path = "test-gauge-file.bin";
+    Configuration const links = make_hot_start(4, 6, 1, 0);
+    save_gauge_file(path, links, 2.3, 42);
+
+    GaugeFileHeader const header = read_gauge_file_header(path);
+    EXPECT_EQ(header.version, 1);
+    EXPECT_EQ(header.length_space, 4);
+    EXPECT_EQ(header.length_time, 6);
+    EXPECT_EQ(header.precision, "double");
+    EXPECT_EQ(header.beta, 2.3);
+    EXPECT_EQ(header.trajectory, 42);
+    EXPECT_EQ(header.checksum, gauge_file_checksum(links));
+
+    Configuration const loaded = load_gauge_file(path);
+    MappedGaugeFile const mapped(path);
+    EXPECT_TRUE(mapped.verify_checksum());
+    ASSERT_EQ(loaded.get_volume(), links.get_volume());
+    ASSERT_EQ(mapped.get_volume(), links.get_volume());
+    for (int site = 0; site < links.get_volume(); ++site) {
+        for (int mu = 0; mu < 4; ++mu) {
+            for (int c = 0; c < 4; ++c) {
+                ASSERT_EQ(loaded(site, mu)[c], links(site, mu)[c]);
+                ASSERT_EQ(mapped(site, mu)[c], links(site, mu)[c]);
+            }
+        }
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST(gaugeFile, detectsCorruption) {
+    std::string const path = "test-gauge-file-corrupt.bin";
+    Configuration const links = make_hot_start(4, 4, 1, 0);
+    save_gauge_file(path, links, 2.3, 0);
+
+    {
+        std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekp(gauge_file_header_size + 100);
+        fs.put('x');
+    }
+    EXPECT_THROW(load_gauge_file(path), std::runtime_error);
+    EXPECT_FALSE(MappedGaugeFile(path).verify_checksum());
+
+    std::remove(path.c_str());
+}
+
+TEST(gaugeFile, detectsTruncation) {
+    std::string const path = "test-gauge-file-short.bin";
+    Configuration const links = make_hot_start(4, 4, 1, 0);
+    links.save(path);
+
+    // A raw dump has no header.
+    EXPECT_THROW(read_gauge_file_header(path), std::runtime_error);
+
+    save_gauge_file(path, links, 2.3, 0);
+    {
+        std::ifstream is(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(is)),
+                            std::istreambuf_iterator<char>());
+        std::ofstream os(path, std::ios::binary);
+        os.write(content.data(), content.size() / 2);
+    }
+    EXPECT_THROW(load_gauge_file(path), std::runtime_error);
+    EXPECT_THROW(MappedGaugeFile{path}, std::runtime_error);
+
+    Configuration raw(4, 4);
+    EXPECT_THROW(raw.load(path + ".missing"), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+namespace {
+long get_file_size(std::string const &path) {
+    std::ifstream is(path, std::ios::binary | std::ios::ate);
+    return is.tellg();
+}
+}  // namespace
+
+TEST(gaugeFile, compressedCodecs) {
+    std::string const path = "test-gauge-file-codec.bin";
+    Configuration const links = make_hot_start(4, 4, 1, 0);
+    double const plaquette = get_plaquette_trace_average(links).real();
+
+    save_gauge_file(path, links, 2.3, 0, GaugeCodec::quaternion_double);
+    auto const full_size = get_file_size(path);
+
+    struct Case {
+        GaugeCodec codec;
+        double max_link_error;
+        double max_plaquette_error;
+        double min_compression;
+    };
+    Case const cases[] = {{GaugeCodec::reconstruct_double, 1e-7, 1e-12, 1.3},
+                          {GaugeCodec::quaternion_single, 1e-6, 1e-7, 1.9},
+                          {GaugeCodec::reconstruct_single, 1e-6, 1e-7, 2.5}};
+
+    for (auto const &c : cases) {
+        save_gauge_file(path, links, 2.3, 7, c.codec);
+        auto const size = get_file_size(path);
+        EXPECT_GT(static_cast<double>(full_size - gauge_file_header_size) /
+                      (size - gauge_file_header_size),
+                  c.min_compression);
+
+        GaugeFileHeader const header = read_gauge_file_header(path);
+        EXPECT_EQ(header.codec, c.codec);
+        EXPECT_EQ(header.trajectory, 7);
+        EXPECT_THROW(MappedGaugeFile{path}, std::runtime_error);
+
+        Configuration const loaded = load_gauge_file(path);
+        for (int i = 0; i < links.get_size(); ++i) {
+            EXPECT_NEAR(loaded[i].determinant(), 1.0, 1e-14);
+            for (int k = 0; k < 4; ++k) {
+                ASSERT_NEAR(loaded[i][k], links[i][k], c.max_link_error);
+            }
+        }
+        EXPECT_NEAR(get_plaquette_trace_average(loaded).real(), plaquette,
+                    c.max_plaquette_error);
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST(gaugeFile, codecNames) {
+    EXPECT_EQ(parse_gauge_codec("double"), GaugeCodec::quaternion_double);
+    EXPECT_EQ(parse_gauge_codec("reconstruct"), GaugeCodec::reconstruct_double);
+    EXPECT_EQ(parse_gauge_codec("single"), GaugeCodec::quaternion_single);
+    EXPECT_EQ(parse_gauge_codec("single-reconstruct"), GaugeCodec::reconstruct_single);
+    EXPECT_THROW(parse_gauge_codec("zip"), std::invalid_argument);
+}
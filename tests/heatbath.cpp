@@ -0,0 +1,97 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../heatbath.hpp"
+#include "../hybrid-monte-carlo.hpp"
+#include "../sanity-checks.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+TEST(heatbath, oddExtents) {
+    ASSERT_THROW(Heatbath(3, 4, 0), std::invalid_argument);
+}
+
+TEST(heatbath, linkIsUnitary) {
+    CounterRng const rng(0, CounterRng::Purpose::heatbath, 0);
+    LinkUniforms uniform(rng, 0);
+    Quaternion const staples(0.3, -1.2, 0.5, 2.0);
+
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(is_unitary(heatbath_link(staples, 2.3, uniform)));
+    }
+    ASSERT_TRUE(is_unitary(heatbath_link(Quaternion(), 2.3, uniform)));
+}
+
+TEST(heatbath, linkDistribution) {
+    // With the staples being the identity, x_0 is distributed with
+    // sqrt(1 - x_0^2) exp(β x_0), its mean is I_2(β) / I_1(β).
+    CounterRng const rng(0, CounterRng::Purpose::heatbath, 0);
+    double const beta = 2.0;
+
+    int const samples = 100000;
+    double sum = 0.0;
+    for (int i = 0; i < samples; ++i) {
+        LinkUniforms uniform(rng, i);
+        sum += heatbath_link(Quaternion::identity(), beta, uniform)[0];
+    }
+
+    // I_2(2) / I_1(2) = 0.688948 / 1.590637.
+    ASSERT_NEAR(sum / samples, 0.433127, 0.005);
+}
+
+TEST(heatbath, overrelaxationKeepsAction) {
+    auto links = make_hot_start(4, 4, 0.5, 0);
+    double const old_energy = get_link_energy(links, 2.3);
+
+    Heatbath heatbath(4, 4, 0);
+    heatbath.overrelaxation_sweep(links);
+
+    ASSERT_NEAR(get_link_energy(links, 2.3), old_energy, 1e-8 * old_energy);
+    for (int i = 0; i < links.get_size(); ++i) {
+        ASSERT_TRUE(is_unitary(links[i]));
+    }
+}
+
+TEST(heatbath, ordersAtLargeBeta) {
+    auto links = make_hot_start(4, 4, 10.0, 0);
+    double const hot_plaquette = get_plaquette_trace_average(links).real();
+
+    Heatbath heatbath(4, 4, 0);
+    for (int i = 0; i < 20; ++i) {
+        heatbath.update(links, 20.0, 1, i);
+    }
+
+    ASSERT_LT(hot_plaquette, 0.5);
+    ASSERT_GT(get_plaquette_trace_average(links).real(), 0.9);
+}
+
+TEST(heatbath, independentOfThreads) {
+    Configuration const start = make_hot_start(4, 4, 1, 0);
+    Heatbath heatbath(4, 4, 3);
+
+    Configuration reference = start;
+    heatbath.update(reference, 2.3, 1, 7);
+    Configuration other_sweep = start;
+    heatbath.update(other_sweep, 2.3, 1, 8);
+    EXPECT_NE(other_sweep[0][0], reference[0][0]);
+
+#ifdef _OPENMP
+    int const threads = omp_get_max_threads();
+    for (int const count : {1, 3}) {
+        omp_set_num_threads(count);
+        Configuration links = start;
+        heatbath.update(links, 2.3, 1, 7);
+        for (int i = 0; i < links.get_size(); ++i) {
+            for (int c = 0; c < 4; ++c) {
+                ASSERT_EQ(links[i][c], reference[i][c]) << count;
+            }
+        }
+    }
+    omp_set_num_threads(threads);
+#endif
+}
@@ -33,7 +33,7 @@ TEST(hybridMonteCarlo, randomizeAlgebra) {
     std::mt19937 engine(0);
     std::normal_distribution<double> dist(0, 1);
 
-    Configuration config(10, 10);
+    MomentumConfiguration config(10, 10);
     randomize_algebra(config, engine, dist);
     for (int i = 0; i < config.get_size(); ++i) {
         ASSERT_TRUE(is_hermitian(config[i])) << "Happened at i = " << i << "\n"
@@ -66,11 +66,11 @@ TEST(hybridMonteCarlo, randomizeGroup) {
     for (int i = 0; i < config.get_size(); ++i) {
         ASSERT_TRUE(is_unitary(config[i])) << "Happened at i = " << i << "\n"
                                            << config[i] << "\nU U^\\dagger:\n"
-                                           << (config[i] * config[i].adjoint().eval());
+                                           << (config[i] * config[i].adjoint());
         ASSERT_TRUE(is_unit_determinant(config[i]))
             << "Happened at i = " << i << "\n"
             << config[i] << "\nU U^\\dagger:\n"
-            << (config[i] * config[i].adjoint().eval());
+            << (config[i] * config[i].adjoint());
     }
 }
 
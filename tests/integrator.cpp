@@ -0,0 +1,247 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../integrator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+double const beta = 2.0;
+double const trajectory_length = 0.5;
+
+/**
+  Integrates one trajectory from a fixed starting point and returns |ΔH|.
+  */
+double energy_violation(std::string const &name, int const md_steps) {
+    Configuration const links = make_hot_start(4, 4, 0.2, 0);
+    Configuration proposal(4, 4);
+
+    std::mt19937 engine(1);
+    std::normal_distribution<double> dist(0, 1);
+    MomentumConfiguration momenta(4, 4);
+    randomize_algebra(momenta, engine, dist);
+
+    double const old_energy = get_energy(links, momenta, beta);
+
+    MdState state(links, proposal, momenta, beta, Layout::array_of_structures);
+    make_integrator(name)->integrate(state, trajectory_length / md_steps, md_steps);
+
+    return std::abs(get_energy(proposal, momenta, beta) - old_energy);
+}
+}
+
+TEST(integrator, unknownName) {
+    ASSERT_THROW(make_integrator("euler"), std::invalid_argument);
+}
+
+TEST(integrator, secondOrder) {
+    for (auto const name : {"leapfrog", "omelyan"}) {
+        double const coarse = energy_violation(name, 8);
+        double const fine = energy_violation(name, 16);
+        double const ratio = coarse / fine;
+        EXPECT_GT(ratio, 3.0) << name;
+        EXPECT_LT(ratio, 5.0) << name;
+    }
+}
+
+TEST(integrator, fourthOrder) {
+    for (auto const name : {"omf4", "force-gradient"}) {
+        double const coarse = energy_violation(name, 4);
+        double const fine = energy_violation(name, 8);
+        double const ratio = coarse / fine;
+        EXPECT_GT(ratio, 12.0) << name;
+        EXPECT_LT(ratio, 20.0) << name;
+    }
+}
+
+TEST(integrator, omelyanBeatsLeapfrog) {
+    ASSERT_LT(energy_violation("omelyan", 8), energy_violation("leapfrog", 8));
+}
+
+TEST(integrator, reversibility) {
+    for (auto const name : {"leapfrog", "omelyan", "omf4", "force-gradient"}) {
+        Configuration const links = make_hot_start(4, 4, 0.2, 0);
+        Configuration forward(4, 4);
+        Configuration backward(4, 4);
+
+        std::mt19937 engine(1);
+        std::normal_distribution<double> dist(0, 1);
+        MomentumConfiguration momenta(4, 4);
+        randomize_algebra(momenta, engine, dist);
+
+        auto const integrator = make_integrator(name);
+        MdState forward_state(links, forward, momenta, beta, Layout::array_of_structures);
+        integrator->integrate(forward_state, 0.1, 5);
+
+        for (int i = 0; i < momenta.get_size(); ++i) {
+            momenta[i] *= -1.0;
+        }
+
+        MdState backward_state(forward, backward, momenta, beta,
+                               Layout::array_of_structures);
+        integrator->integrate(backward_state, 0.1, 5);
+
+        for (int i = 0; i < links.get_size(); ++i) {
+            for (int c = 0; c < 4; ++c) {
+                ASSERT_NEAR(links[i][c], backward[i][c], 1e-10)
+                    << name << ", happened at i = " << i;
+            }
+        }
+    }
+}
+
+TEST(integrator, plaquetteFromForce) {
+    for (auto const layout : {Layout::array_of_structures, Layout::structure_of_arrays,
+                              Layout::plaquette}) {
+        for (auto const name : {"leapfrog", "omf4", "force-gradient"}) {
+            Configuration const links = make_hot_start(4, 4, 0.2, 0);
+            Configuration proposal(4, 4);
+
+            std::mt19937 engine(1);
+            std::normal_distribution<double> dist(0, 1);
+            MomentumConfiguration momenta(4, 4);
+            randomize_algebra(momenta, engine, dist);
+
+            MdState state(links, proposal, momenta, beta, layout);
+            make_integrator(name)->integrate(state, 0.1, 3);
+            state.finish();
+
+            ASSERT_NEAR(state.get_plaquette_trace_sum(),
+                        get_plaquette_trace_sum(proposal).real(), 1e-9)
+                << name;
+        }
+    }
+}
+
+TEST(integrator, reusedState) {
+    // A state kept across trajectories gives the same as a fresh one for each.
+    struct Setup {
+        Layout layout;
+        Precision precision;
+    };
+    for (auto const setup : {Setup{Layout::array_of_structures, Precision::full},
+                             Setup{Layout::structure_of_arrays, Precision::full},
+                             Setup{Layout::plaquette, Precision::full},
+                             Setup{Layout::array_of_structures, Precision::mixed}}) {
+        Configuration links = make_hot_start(4, 4, 0.2, 0);
+        auto const integrator = make_integrator("force-gradient");
+
+        Configuration proposal(4, 4);
+        MomentumConfiguration momenta(4, 4);
+        MdState state(proposal, momenta, beta, setup.layout, setup.precision);
+
+        for (int trajectory = 0; trajectory < 2; ++trajectory) {
+            std::mt19937 engine(trajectory);
+            std::normal_distribution<double> dist(0, std::sqrt(0.5));
+            randomize_algebra(momenta, engine, dist);
+            MomentumConfiguration fresh_momenta = momenta;
+            Configuration fresh_proposal(4, 4);
+
+            double const plaquette_trace_sum = get_plaquette_trace_sum(links).real();
+            double proposal_plaquette_trace_sum, fresh_plaquette_trace_sum;
+            double const energy_difference =
+                md_evolution(state, links, *integrator, 0.1, 3, plaquette_trace_sum,
+                             proposal_plaquette_trace_sum);
+            double const fresh_energy_difference = md_evolution(
+                links, fresh_proposal, fresh_momenta, *integrator, 0.1, 3, beta,
+                setup.layout, plaquette_trace_sum, fresh_plaquette_trace_sum,
+                setup.precision);
+
+            ASSERT_EQ(energy_difference, fresh_energy_difference) << trajectory;
+            ASSERT_EQ(proposal_plaquette_trace_sum, fresh_plaquette_trace_sum);
+            for (int i = 0; i < links.get_size(); ++i) {
+                for (int c = 0; c < 4; ++c) {
+                    ASSERT_EQ(proposal[i][c], fresh_proposal[i][c]) << trajectory;
+                }
+            }
+            std::swap(links, proposal);
+        }
+    }
+}
+
+TEST(integrator, mixedPrecisionReversibility) {
+    for (auto const name : {"leapfrog", "force-gradient"}) {
+        Configuration const links = make_hot_start(4, 4, 0.2, 0);
+        Configuration forward(4, 4);
+        Configuration backward(4, 4);
+
+        std::mt19937 engine(1);
+        std::normal_distribution<double> dist(0, 1);
+        MomentumConfiguration momenta(4, 4);
+        randomize_algebra(momenta, engine, dist);
+
+        auto const integrator = make_integrator(name);
+        MdState forward_state(links, forward, momenta, beta, Layout::array_of_structures,
+                              Precision::mixed, 3);
+        integrator->integrate(forward_state, 0.1, 5);
+        forward_state.finish();
+
+        for (int i = 0; i < momenta.get_size(); ++i) {
+            momenta[i] *= -1.0;
+        }
+
+        MdState backward_state(forward, backward, momenta, beta,
+                               Layout::array_of_structures, Precision::mixed, 3);
+        integrator->integrate(backward_state, 0.1, 5);
+        backward_state.finish();
+
+        for (int i = 0; i < links.get_size(); ++i) {
+            ASSERT_NEAR(backward[i].determinant(), 1.0, 1e-14) << name;
+            for (int c = 0; c < 4; ++c) {
+                // Single precision rounding, amplified by the trajectory.
+                ASSERT_NEAR(links[i][c], backward[i][c], 1e-6)
+                    << name << ", happened at i = " << i;
+            }
+        }
+    }
+}
+
+TEST(integrator, mixedPrecisionAcceptance) {
+    // The energy difference decides the acceptance, in mixed precision it has to
+    // agree with the one in double precision.
+    Configuration const links = make_hot_start(4, 4, 0.2, 0);
+    double const plaquette_trace_sum = get_plaquette_trace_sum(links).real();
+    auto const integrator = make_integrator("omelyan");
+
+    std::mt19937 engine(1);
+    std::normal_distribution<double> dist(0, 1);
+    MomentumConfiguration momenta(4, 4);
+    randomize_algebra(momenta, engine, dist);
+
+    double energy_differences[2];
+    Configuration proposals[2] = {Configuration(4, 4), Configuration(4, 4)};
+    Precision const precisions[2] = {Precision::full, Precision::mixed};
+    for (int i = 0; i < 2; ++i) {
+        MomentumConfiguration evolved = momenta;
+        double proposal_plaquette_trace_sum;
+        energy_differences[i] = md_evolution(
+            links, proposals[i], evolved, *integrator, 0.05, 10, beta,
+            Layout::array_of_structures, plaquette_trace_sum,
+            proposal_plaquette_trace_sum, precisions[i]);
+        ASSERT_NEAR(proposal_plaquette_trace_sum,
+                    get_plaquette_trace_sum(proposals[i]).real(), 1e-9);
+    }
+
+    EXPECT_NEAR(energy_differences[1], energy_differences[0], 1e-4);
+    double const acceptances[2] = {std::min(1.0, std::exp(-energy_differences[0])),
+                                   std::min(1.0, std::exp(-energy_differences[1]))};
+    EXPECT_NEAR(acceptances[1], acceptances[0], 1e-4);
+    for (int i = 0; i < links.get_size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            ASSERT_NEAR(proposals[1][i][c], proposals[0][i][c], 1e-6);
+        }
+    }
+}
+
+TEST(integrator, mixedPrecisionLayout) {
+    Configuration const links = make_hot_start(4, 4, 0.2, 0);
+    Configuration proposal(4, 4);
+    MomentumConfiguration momenta(4, 4);
+    ASSERT_THROW(MdState(links, proposal, momenta, beta, Layout::structure_of_arrays,
+                         Precision::mixed),
+                 std::invalid_argument);
+}
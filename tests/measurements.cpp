@@ -0,0 +1,182 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../measurements.hpp"
+
+#include "../hybrid-monte-carlo.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+Configuration make_cold_start(int const length_space, int const length_time) {
+    Configuration links(length_space, length_time);
+    for (int i = 0; i < links.get_size(); ++i) {
+        links[i] = Quaternion::identity();
+    }
+    return links;
+}
+
+std::vector<std::unique_ptr<Observable>> make_all_observables(int const length_space,
+                                                              int const length_time) {
+    boost::property_tree::ptree config;
+    config.put("lattice.length_space", length_space);
+    config.put("lattice.length_time", length_time);
+    config.put("measurements.observables",
+               "plaquette polyakov-loop polyakov-correlator wilson-loops energy-density "
+               "wilson-flow");
+    config.put("wilson-flow.times", "0.1 0.3");
+    config.put("wilson-flow.step", 0.05);
+    config.put("polyakov-correlator.r_max", 2);
+    config.put("wilson-loops.r_max", 2);
+    config.put("wilson-loops.t_max", 3);
+    return make_observables(config);
+}
+}  // namespace
+
+TEST(measurements, coldStart) {
+    Configuration const links = make_cold_start(4, 6);
+    for (auto const &observable : make_all_observables(4, 6)) {
+        std::string const name = observable->get_name();
+        double const expected =
+            name == "energy-density" || name == "wilson-flow" ? 0.0 : 1.0;
+        for (double const value : observable->measure(links)) {
+            EXPECT_NEAR(value, expected, 1e-14) << observable->get_name();
+        }
+    }
+}
+
+TEST(measurements, constantTemporalField) {
+    // A constant field is a pure gauge except for the Polyakov loop.
+    double const angle = 0.3;
+    Configuration links = make_cold_start(4, 6);
+    for (int site = 0; site < links.get_volume(); ++site) {
+        links(site, 0) = Quaternion(std::cos(angle), 0.0, 0.0, std::sin(angle));
+    }
+
+    EXPECT_NEAR(PolyakovLoopObservable().measure(links)[0], std::cos(6 * angle), 1e-14);
+    for (double const value : WilsonLoopsObservable(4, 6, 3, 3).measure(links)) {
+        EXPECT_NEAR(value, 1.0, 1e-14);
+    }
+}
+
+TEST(measurements, gaugeInvariance) {
+    Configuration const links = make_hot_start(4, 4, 0.5, 1);
+    Configuration const transformations = make_hot_start(4, 4, 1.0, 2);
+
+    // U'_mu(x) = g(x) U_mu(x) g(x + mu)^dagger with g(x) taken from direction 0.
+    NeighborTable const &neighbors = links.get_neighbors();
+    Configuration transformed(4, 4);
+    for (int site = 0; site < links.get_volume(); ++site) {
+        for (int mu = 0; mu < 4; ++mu) {
+            transformed(site, mu) =
+                transformations(site, 0) * links(site, mu) *
+                transformations(neighbors.forward(site, mu), 0).adjoint();
+        }
+    }
+
+    for (auto const &observable : make_all_observables(4, 4)) {
+        auto const expected = observable->measure(links);
+        auto const actual = observable->measure(transformed);
+        ASSERT_EQ(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_NEAR(actual[i], expected[i], 1e-12) << observable->get_name();
+        }
+    }
+}
+
+TEST(measurements, plaquette) {
+    Configuration const links = make_hot_start(4, 4, 0.5, 1);
+    auto const values = PlaquetteObservable().measure(links);
+    ASSERT_EQ(values.size(), 3);
+    EXPECT_NEAR(values[0], get_plaquette_trace_average(links).real(), 1e-14);
+    EXPECT_NEAR(values[0], (values[1] + values[2]) / 2, 1e-14);
+
+    auto const loops = WilsonLoopsObservable(4, 4, 1, 1).measure(links);
+    ASSERT_EQ(loops.size(), 1);
+    EXPECT_NEAR(loops[0], values[2], 1e-14);
+
+    EXPECT_NEAR(EnergyDensityObservable().measure(links)[0],
+                24 * (1 - values[0]), 1e-12);
+
+    // Flowing in two parts is the same as flowing at once.
+    WilsonFlowObservable const flow(4, 4, {0.2, 0.4}, 0.1, 0.0);
+    auto const flowed = flow.measure(links);
+    ASSERT_EQ(flowed.size(), 4);
+    Configuration copy = links;
+    WilsonFlow(4, 4, 0.1).flow(copy, 0.4);
+    CloverObservables const clover = measure_clover(copy);
+    EXPECT_NEAR(flowed[2], 0.4 * 0.4 * clover.energy_density, 1e-12);
+    EXPECT_NEAR(flowed[3], clover.topological_charge, 1e-12);
+}
+
+TEST(measurements, factory) {
+    boost::property_tree::ptree config;
+    EXPECT_TRUE(make_observables(config).empty());
+    EXPECT_THROW(make_observable("topological-charge", config), std::invalid_argument);
+
+    config.put("lattice.length_space", 4);
+    config.put("lattice.length_time", 4);
+    config.put("wilson-loops.r_max", 5);
+    EXPECT_THROW(make_observable("wilson-loops", config), std::invalid_argument);
+    config.put("polyakov-correlator.r_max", -1);
+    EXPECT_THROW(make_observable("polyakov-correlator", config), std::invalid_argument);
+    config.put("wilson-flow.times", "0.5 0.2");
+    EXPECT_THROW(make_observable("wilson-flow", config), std::invalid_argument);
+}
+
+TEST(measurements, pipeline) {
+    auto observables = make_all_observables(4, 4);
+    std::vector<std::string> names;
+    std::vector<MeasurementProgress> progress;
+    {
+        MeasurementPipeline pipeline(std::move(observables), false, 1, 2);
+        names = pipeline.get_output_names();
+        ASSERT_EQ(names.size(), 6);
+        EXPECT_EQ(names[0], "measurement-plaquette.tsv");
+        for (auto const &initial : pipeline.get_progress()) {
+            EXPECT_EQ(initial.trajectory, 0);
+            EXPECT_EQ(initial.size, 0);
+        }
+
+        Configuration links = make_cold_start(4, 4);
+        for (int trajectory = 1; trajectory <= 5; ++trajectory) {
+            pipeline.submit(trajectory, links);
+            // The pipeline has its own copy.
+            links = make_hot_start(4, 4, 0.5, trajectory);
+        }
+        pipeline.wait();
+        progress = pipeline.get_progress();
+    }
+
+    // Appending continues from the end of the existing files.
+    {
+        MeasurementPipeline pipeline(make_all_observables(4, 4), true, 1, 2);
+        auto const appended = pipeline.get_progress();
+        for (size_t i = 0; i < names.size(); ++i) {
+            EXPECT_EQ(appended[i].size, progress[i].size) << names[i];
+        }
+    }
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::string const &name = names[i];
+        EXPECT_EQ(progress[i].trajectory, 5) << name;
+        {
+            std::ifstream is(name, std::ios::binary | std::ios::ate);
+            EXPECT_EQ(static_cast<std::uintmax_t>(is.tellg()), progress[i].size)
+                << name;
+        }
+
+        std::ifstream is(name);
+        std::string line;
+        for (int trajectory = 1; trajectory <= 5; ++trajectory) {
+            ASSERT_TRUE(std::getline(is, line)) << name;
+            EXPECT_EQ(std::stoi(line), trajectory);
+        }
+        EXPECT_FALSE(std::getline(is, line));
+        std::remove(name.c_str());
+    }
+}
@@ -0,0 +1,95 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../metrics.hpp"
+
+#include "../hybrid-monte-carlo.hpp"
+#include "../integrator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <random>
+#include <string>
+
+TEST(metrics, accumulatesPhases) {
+    PhaseTimers timers;
+    timers.add(Phase::force, 0.25);
+    timers.add(Phase::force, 0.5);
+    timers.add(Phase::io, 1.0);
+    EXPECT_DOUBLE_EQ(timers.get_seconds(Phase::force), 0.75);
+    EXPECT_EQ(timers.get_calls(Phase::force), 2);
+    EXPECT_EQ(timers.get_calls(Phase::io), 1);
+    EXPECT_EQ(timers.get_calls(Phase::link), 0);
+
+    timers.reset();
+    EXPECT_EQ(timers.get_seconds(Phase::force), 0.0);
+    EXPECT_EQ(timers.get_calls(Phase::force), 0);
+}
+
+TEST(metrics, scopedTimer) {
+    PhaseTimers timers;
+    {
+        ScopedTimer const timer(&timers, Phase::heatbath);
+    }
+    EXPECT_EQ(timers.get_calls(Phase::heatbath), 1);
+    EXPECT_GE(timers.get_seconds(Phase::heatbath), 0.0);
+
+    // Without timers nothing happens.
+    {
+        ScopedTimer const timer(nullptr, Phase::heatbath);
+    }
+}
+
+TEST(metrics, json) {
+    TrajectoryMetrics metrics;
+    metrics.trajectory = 12;
+    metrics.accepted = true;
+    metrics.energy_difference = std::numeric_limits<double>::quiet_NaN();
+    metrics.acceptance_rate = 0.75;
+    metrics.plaquette = 0.5;
+    metrics.thermalized = false;
+    metrics.plaquette_error = std::numeric_limits<double>::infinity();
+    metrics.tuning = true;
+    metrics.time_step = 0.125;
+    metrics.md_steps = 8;
+    metrics.seconds = 2.0;
+    metrics.phases.add(Phase::force, 0.25);
+
+    std::string const json = to_json(metrics);
+    EXPECT_EQ(json.find("{\"trajectory\": 12, \"accepted\": true, \"delta_h\": null, "
+                        "\"acceptance_rate\": 0.75, \"plaquette\": 0.5, "
+                        "\"thermalized\": false, \"plaquette_error\": null, "
+                        "\"tuning\": true, \"time_step\": 0.125, \"md_steps\": 8, "
+                        "\"seconds\": 2, \"phases\": {"),
+              0);
+    EXPECT_NE(json.find("\"force\": {\"seconds\": 0.25, \"calls\": 1}"),
+              std::string::npos);
+    for (int i = 0; i < number_of_phases; ++i) {
+        std::string const name = get_phase_name(static_cast<Phase>(i));
+        EXPECT_NE(json.find("\"" + name + "\": {"), std::string::npos) << name;
+    }
+    EXPECT_EQ(json.substr(json.size() - 2), "}}");
+    EXPECT_EQ(json.find('\n'), std::string::npos);
+}
+
+TEST(metrics, mdEvolution) {
+    Configuration const links = make_hot_start(4, 4, 0.2, 0);
+    Configuration proposal(4, 4);
+    MomentumConfiguration momenta(4, 4);
+    std::mt19937 engine(1);
+    std::normal_distribution<double> dist(0, 1);
+    randomize_algebra(momenta, engine, dist);
+    auto const integrator = make_integrator("leapfrog");
+
+    PhaseTimers timers;
+    double proposal_plaquette_trace_sum;
+    md_evolution(links, proposal, momenta, *integrator, 0.05, 10, 2.3,
+                 Layout::array_of_structures, get_plaquette_trace_sum(links).real(),
+                 proposal_plaquette_trace_sum, Precision::full, 10, &timers);
+
+    // Every thread of the team runs the steps, only one of them records.
+    EXPECT_EQ(timers.get_calls(Phase::link), 10);
+    EXPECT_GE(timers.get_calls(Phase::force), 11);
+    EXPECT_EQ(timers.get_calls(Phase::energy), 2);
+    EXPECT_EQ(timers.get_calls(Phase::io), 0);
+}
@@ -0,0 +1,54 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../configuration.hpp"
+#include "../neighbor-table.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(neighborTable, matchesCoordinates) {
+    Configuration const links(3, 5);
+    NeighborTable const &neighbors = links.get_neighbors();
+
+    for (int n1 = 0; n1 < links.length_time; ++n1) {
+        for (int n2 = 0; n2 < links.length_space; ++n2) {
+            for (int n3 = 0; n3 < links.length_space; ++n3) {
+                for (int n4 = 0; n4 < links.length_space; ++n4) {
+                    std::vector<int> const coords{n1, n2, n3, n4};
+                    int const site = links.get_site(n1, n2, n3, n4);
+                    for (int mu = 0; mu < 4; ++mu) {
+                        auto shifted = coords;
+                        ++shifted[mu];
+                        ASSERT_EQ(links.get_site(shifted[0], shifted[1], shifted[2],
+                                                 shifted[3]),
+                                  neighbors.forward(site, mu));
+
+                        shifted = coords;
+                        --shifted[mu];
+                        ASSERT_EQ(links.get_site(shifted[0], shifted[1], shifted[2],
+                                                 shifted[3]),
+                                  neighbors.backward(site, mu));
+
+                        for (int nu = 0; nu < 4; ++nu) {
+                            shifted = coords;
+                            ++shifted[mu];
+                            --shifted[nu];
+                            ASSERT_EQ(links.get_site(shifted[0], shifted[1], shifted[2],
+                                                     shifted[3]),
+                                      neighbors.diagonal(site, mu, nu));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(neighborTable, shared) {
+    Configuration const links1(4, 6);
+    Configuration const links2(4, 6);
+    Configuration const links3(6, 4);
+
+    ASSERT_EQ(&links1.get_neighbors(), &links2.get_neighbors());
+    ASSERT_NE(&links1.get_neighbors(), &links3.get_neighbors());
+    ASSERT_EQ(0, links1.get_neighbors().get_padded_volume() % NeighborTable::padding);
+}
@@ -0,0 +1,52 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../hybrid-monte-carlo.hpp"
+#include "../plaquette-force.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(plaquetteForce, linksStaplesMatchStaples) {
+    // Odd and unequal extents to catch mix-ups in the strides.
+    Configuration const links = make_hot_start(3, 5, 1, 0);
+    Configuration links_staples(3, 5);
+
+    double const plaquette_trace_sum = get_links_staples(links, links_staples);
+    ASSERT_NEAR(plaquette_trace_sum, get_plaquette_trace_sum(links).real(), 1e-9);
+
+    for (int site = 0; site < links.get_volume(); ++site) {
+        for (int mu = 0; mu < 4; ++mu) {
+            Quaternion const expected = links(site, mu) * get_staples(site, mu, links);
+            for (int c = 0; c < 4; ++c) {
+                ASSERT_NEAR(links_staples(site, mu)[c], expected[c], 1e-12)
+                    << "Happened at site = " << site << ", mu = " << mu;
+            }
+        }
+    }
+}
+
+TEST(plaquetteForce, momentumStepMatchesPerLink) {
+    double const beta = 2.3;
+    double const time_step = 0.1;
+
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    Configuration const links = make_hot_start(4, 4, 1, 0);
+    Configuration links_staples(4, 4);
+    MomentumConfiguration momenta(4, 4);
+    randomize_algebra(momenta, engine, dist);
+    MomentumConfiguration plaquette_momenta = momenta;
+
+    double const plaquette_trace_sum =
+        md_momentum_step(links, momenta, time_step, beta);
+    double const plaquette_plaquette_trace_sum =
+        md_momentum_step(links, links_staples, plaquette_momenta, time_step, beta);
+
+    ASSERT_NEAR(plaquette_plaquette_trace_sum, plaquette_trace_sum, 1e-9);
+    for (int i = 0; i < momenta.get_size(); ++i) {
+        for (int c = 0; c < 3; ++c) {
+            ASSERT_NEAR(plaquette_momenta[i][c], momenta[i][c], 1e-12)
+                << "Happened at i = " << i;
+        }
+    }
+}
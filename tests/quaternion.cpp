@@ -0,0 +1,132 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../pauli-matrices.hpp"
+#include "../quaternion.hpp"
+#include "../sanity-checks.hpp"
+
+#include <gtest/gtest.h>
+#include <unsupported/Eigen/MatrixFunctions>
+
+#include <cmath>
+#include <random>
+
+TEST(quaternion, roundTrip) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (int i = 0; i < 10; ++i) {
+        Matrix const mat = random_from_group(engine, dist);
+        Quaternion const q(mat);
+        ASSERT_TRUE(is_equal(mat, q.to_matrix())) << "Happened at i = " << i << "\n"
+                                                  << mat << "\n"
+                                                  << q;
+        ASSERT_NEAR(1.0, q.determinant(), 1e-10);
+    }
+}
+
+TEST(quaternion, multiplication) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (int i = 0; i < 10; ++i) {
+        Matrix const m1 = random_from_group(engine, dist);
+        Matrix const m2 = random_from_group(engine, dist);
+        Matrix const expected = m1 * m2;
+        Quaternion const actual = Quaternion(m1) * Quaternion(m2);
+        ASSERT_TRUE(is_equal(expected, actual)) << "Happened at i = " << i << "\n"
+                                                << expected << "\n"
+                                                << actual;
+    }
+}
+
+TEST(quaternion, adjointAndTrace) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (int i = 0; i < 10; ++i) {
+        Matrix const mat = random_from_group(engine, dist);
+        Quaternion const q(mat);
+        ASSERT_TRUE(is_equal(mat.adjoint(), q.adjoint()));
+        ASSERT_NEAR(mat.trace().real(), q.trace(), 1e-10);
+        ASSERT_TRUE(is_unity(q * q.adjoint()));
+    }
+}
+
+TEST(quaternion, sumOfGroupElements) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    Matrix const m1 = random_from_group(engine, dist);
+    Matrix const m2 = random_from_group(engine, dist);
+    Matrix const m3 = random_from_group(engine, dist);
+
+    // Staples are sums of SU(2) matrices, they must stay representable.
+    Matrix const sum = m1 + m2;
+    Quaternion const q_sum = Quaternion(m1) + Quaternion(m2);
+    ASSERT_TRUE(is_equal(sum, q_sum));
+    ASSERT_TRUE(is_equal(m3 * sum, Quaternion(m3) * q_sum));
+}
+
+TEST(quaternion, expAgainstEigen) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (double const scale : {1e-9, 1e-5, 1e-3, 0.1, 1.0, 3.0}) {
+        for (int i = 0; i < 10; ++i) {
+            Matrix const algebra = scale * random_from_algebra(engine, dist);
+            Matrix const exponent = imag_unit * algebra;
+            Matrix const expected = exponent.exp();
+            Quaternion const actual = exp(Quaternion(exponent));
+            ASSERT_TRUE(is_equal(expected, actual)) << "Happened at scale = " << scale
+                                                    << ", i = " << i << "\n"
+                                                    << expected << "\n"
+                                                    << actual;
+            ASSERT_TRUE(is_equal(expected, group_from_algebra(algebra)));
+        }
+    }
+}
+
+TEST(quaternion, logInvertsExp) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (double const scale : {1e-12, 1e-5, 0.1, 1.0}) {
+        for (int i = 0; i < 10; ++i) {
+            Matrix const algebra = scale * random_from_algebra(engine, dist);
+            Quaternion const group = exp(Quaternion(imag_unit * algebra));
+            Quaternion const log_group = log(group);
+            ASSERT_TRUE(is_equal(group, exp(log_group)))
+                << "Happened at scale = " << scale << ", i = " << i << "\n"
+                << group << "\n"
+                << log_group;
+            ASSERT_NEAR(0.0, log_group[0], 1e-10);
+        }
+    }
+
+    Matrix const group = random_from_group(engine, dist);
+    Matrix const expected = group.log();
+    ASSERT_TRUE(is_equal(expected, log(Quaternion(group))));
+}
+
+TEST(quaternion, logAtMinusIdentity) {
+    double const pi = std::acos(-1);
+    Quaternion const minus_identity(-1, 0, 0, 0);
+    Quaternion const log_minus = log(minus_identity);
+    ASSERT_NEAR(log_minus[0], 0.0, 1e-15);
+    ASSERT_NEAR(std::sqrt(log_minus[1] * log_minus[1] + log_minus[2] * log_minus[2] +
+                          log_minus[3] * log_minus[3]),
+                pi, 1e-15);
+    ASSERT_TRUE(is_equal(minus_identity, exp(log_minus)));
+
+    // Close to minus the identity the axis is kept and the angle is close to π.
+    double const norm = std::sqrt(3.0);
+    for (double const epsilon : {1e-4, 1e-9, 1e-12}) {
+        Quaternion const q(-std::cos(epsilon), std::sin(epsilon) / norm,
+                           -std::sin(epsilon) / norm, std::sin(epsilon) / norm);
+        Quaternion const log_q = log(q);
+        ASSERT_NEAR(log_q[1], (pi - epsilon) / norm, 1e-12) << epsilon;
+        ASSERT_NEAR(log_q[2], -(pi - epsilon) / norm, 1e-12) << epsilon;
+        ASSERT_NEAR(log_q[3], (pi - epsilon) / norm, 1e-12) << epsilon;
+        ASSERT_TRUE(is_equal(q, exp(log_q))) << epsilon;
+    }
+}
@@ -0,0 +1,105 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../hybrid-monte-carlo.hpp"
+#include "../soa-configuration.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(soaConfiguration, roundTrip) {
+    Configuration const links = make_hot_start(3, 5, 1, 0);
+    SoaConfiguration const soa_links(links);
+
+    Configuration extracted(3, 5);
+    soa_links.extract(extracted);
+
+    for (int i = 0; i < links.get_size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            ASSERT_EQ(links[i][c], extracted[i][c]) << "Happened at i = " << i;
+        }
+    }
+}
+
+TEST(soaConfiguration, momentumDerivativeMatchesScalar) {
+    double const beta = 2.3;
+
+    // The volume 3^3 × 5 is not a multiple of any SIMD width, the tail is tested too.
+    for (int const length_space : {3, 4}) {
+        Configuration const links = make_hot_start(length_space, 5, 1, 0);
+        SoaConfiguration const soa_links(links);
+
+        MomentumConfiguration derivatives(length_space, 5);
+        compute_momentum_derivatives(soa_links, derivatives, beta);
+
+        for (int n1 = 0; n1 < links.length_time; ++n1) {
+            for (int n2 = 0; n2 < links.length_space; ++n2) {
+                for (int n3 = 0; n3 < links.length_space; ++n3) {
+                    for (int n4 = 0; n4 < links.length_space; ++n4) {
+                        for (int mu = 0; mu < 4; ++mu) {
+                            Algebra const expected = compute_momentum_derivative(
+                                n1, n2, n3, n4, mu, links, beta);
+                            Algebra const &actual = derivatives(n1, n2, n3, n4, mu);
+                            for (int c = 0; c < 3; ++c) {
+                                ASSERT_NEAR(expected[c], actual[c], 1e-12)
+                                    << "At: t=" << n1 << ", x=" << n2 << ", y=" << n3
+                                    << ", z=" << n4 << "; mu=" << mu;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(soaConfiguration, momentumStepMatchesScalar) {
+    double const beta = 2.3;
+    double const time_step = 0.1;
+
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    Configuration links = make_hot_start(4, 4, 1, 0);
+    MomentumConfiguration momenta(4, 4);
+    randomize_algebra(momenta, engine, dist);
+    MomentumConfiguration soa_momenta = momenta;
+
+    double const plaquette_trace_sum =
+        md_momentum_step(links, momenta, time_step, beta);
+    double const soa_plaquette_trace_sum =
+        md_momentum_step(SoaConfiguration(links), soa_momenta, time_step, beta);
+
+    ASSERT_NEAR(plaquette_trace_sum, get_plaquette_trace_sum(links).real(), 1e-9);
+    ASSERT_NEAR(soa_plaquette_trace_sum, plaquette_trace_sum, 1e-9);
+
+    for (int i = 0; i < momenta.get_size(); ++i) {
+        for (int c = 0; c < 3; ++c) {
+            ASSERT_NEAR(momenta[i][c], soa_momenta[i][c], 1e-12) << "Happened at i = "
+                                                                 << i;
+        }
+    }
+}
+
+TEST(soaConfiguration, linkStepMatchesScalar) {
+    std::mt19937 engine(0);
+    std::normal_distribution<double> dist(0, 1);
+
+    Configuration const links = make_hot_start(3, 5, 1, 0);
+    MomentumConfiguration momenta(3, 5);
+    randomize_algebra(momenta, engine, dist);
+
+    Configuration new_links(3, 5);
+    md_link_step(links, new_links, momenta, 0.1);
+
+    // In place, like during the molecular dynamics.
+    SoaConfiguration soa_links(links);
+    md_link_step(soa_links, soa_links, momenta, 0.1);
+    Configuration soa_new_links(3, 5);
+    soa_links.extract(soa_new_links);
+
+    for (int i = 0; i < links.get_size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            ASSERT_NEAR(new_links[i][c], soa_new_links[i][c], 1e-15) << "Happened at i = "
+                                                                     << i;
+        }
+    }
+}
@@ -0,0 +1,229 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../statistics.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+/**
+  Autoregressive process \f$ a_{i+1} = \phi a_i + \eta_i \f$ with the integrated
+  autocorrelation time \f$ \frac12 (1 + \phi) / (1 - \phi) \f$.
+  */
+std::vector<double> make_ar1(int const size, double const phi, int const seed) {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> dist(0, 1);
+    std::vector<double> data(size);
+    double value = 0.0;
+    for (int i = 0; i < size; ++i) {
+        value = phi * value + dist(engine);
+        data[i] = value;
+    }
+    return data;
+}
+}  // namespace
+
+TEST(statistics, autocovarianceAgainstSum) {
+    std::vector<double> const data = make_ar1(300, 0.5, 1);
+    double mean = 0.0;
+    for (double const value : data) {
+        mean += value / data.size();
+    }
+
+    std::vector<double> const autocovariance = get_autocovariance(data, 20);
+    ASSERT_EQ(autocovariance.size(), 21);
+    for (int t = 0; t <= 20; ++t) {
+        double sum = 0.0;
+        for (int i = 0; i + t < static_cast<int>(data.size()); ++i) {
+            sum += (data[i] - mean) * (data[i + t] - mean);
+        }
+        EXPECT_NEAR(autocovariance[t], sum / (data.size() - t), 1e-12) << t;
+    }
+}
+
+TEST(statistics, gammaMethodUncorrelated) {
+    std::vector<double> const data = make_ar1(20000, 0.0, 2);
+    GammaResult const result = gamma_method(data);
+    EXPECT_NEAR(result.tau_int, 0.5, 0.05);
+    EXPECT_NEAR(result.mean, 0.0, 4 * result.error);
+    EXPECT_NEAR(result.error, 1 / std::sqrt(20000.0), 0.1 / std::sqrt(20000.0));
+    EXPECT_DOUBLE_EQ(result.rho[0], 1.0);
+}
+
+TEST(statistics, gammaMethodAr1) {
+    double const phi = 0.8;
+    double const tau_int = 0.5 * (1 + phi) / (1 - phi);
+    std::vector<double> const data = make_ar1(100000, phi, 3);
+    GammaResult const result = gamma_method(data);
+    EXPECT_NEAR(result.tau_int, tau_int, 3 * result.tau_int_error);
+    EXPECT_NEAR(result.rho[1], phi, 0.02);
+    EXPECT_GT(result.window, 2 * tau_int);
+
+    // The error of the mean includes the autocorrelation.
+    double const variance = 1 / (1 - phi * phi);
+    EXPECT_NEAR(result.error, std::sqrt(2 * tau_int * variance / data.size()),
+                0.1 * result.error);
+}
+
+TEST(statistics, gammaMethodConstant) {
+    GammaResult const result = gamma_method(std::vector<double>(10, 2.0));
+    EXPECT_EQ(result.mean, 2.0);
+    EXPECT_EQ(result.error, 0.0);
+    EXPECT_EQ(result.tau_int, 0.5);
+}
+
+TEST(statistics, invalidArguments) {
+    EXPECT_THROW(gamma_method({1.0}), std::invalid_argument);
+    EXPECT_THROW(gamma_method({1.0, 2.0}, 0.0), std::invalid_argument);
+    EXPECT_THROW(get_bins({1.0, 2.0}, 0), std::invalid_argument);
+    EXPECT_THROW(binned_jackknife({1.0, 2.0, 3.0}, 2), std::invalid_argument);
+    EXPECT_THROW(binned_bootstrap({1.0, 2.0}, 1, 1, 0), std::invalid_argument);
+}
+
+TEST(statistics, bins) {
+    std::vector<double> const bins = get_bins({1, 2, 3, 4, 5, 6, 7}, 3);
+    ASSERT_EQ(bins.size(), 2);
+    EXPECT_DOUBLE_EQ(bins[0], 2.0);
+    EXPECT_DOUBLE_EQ(bins[1], 5.0);
+}
+
+TEST(statistics, jackknifeIsStandardError) {
+    // For the mean the jackknife reproduces the standard error of the bins.
+    std::vector<double> const data = {1.0, 4.0, 2.0, 8.0, 5.0, 7.0};
+    ErrorEstimate const result = binned_jackknife(data, 1);
+    double const mean = 27.0 / 6;
+    double squares = 0.0;
+    for (double const value : data) {
+        squares += (value - mean) * (value - mean);
+    }
+    EXPECT_DOUBLE_EQ(result.mean, mean);
+    EXPECT_NEAR(result.error, std::sqrt(squares / 5 / 6), 1e-12);
+}
+
+TEST(statistics, binnedErrorsAr1) {
+    // Bins much longer than the autocorrelation time are independent, jackknife
+    // and bootstrap agree with the Γ-method.
+    std::vector<double> const data = make_ar1(100000, 0.8, 4);
+    GammaResult const gamma = gamma_method(data);
+    ErrorEstimate const jackknife = binned_jackknife(data, 100);
+    ErrorEstimate const bootstrap = binned_bootstrap(data, 100, 1000, 0);
+    EXPECT_DOUBLE_EQ(jackknife.mean, bootstrap.mean);
+    EXPECT_NEAR(jackknife.error, gamma.error, 0.15 * gamma.error);
+    EXPECT_NEAR(bootstrap.error, jackknife.error, 0.1 * jackknife.error);
+
+    // Without binning the autocorrelation is missed.
+    EXPECT_LT(binned_jackknife(data, 1).error, 0.5 * gamma.error);
+}
+
+TEST(statistics, bootstrapReproducible) {
+    std::vector<double> const data = make_ar1(1000, 0.5, 5);
+    ErrorEstimate const first = binned_bootstrap(data, 4, 200, 7);
+    ErrorEstimate const second = binned_bootstrap(data, 4, 200, 7);
+    ErrorEstimate const other = binned_bootstrap(data, 4, 200, 8);
+    EXPECT_EQ(first.error, second.error);
+    EXPECT_NE(first.error, other.error);
+}
+
+TEST(statistics, binningLevelsAreJackknife) {
+    std::vector<double> const data = make_ar1(1024, 0.5, 6);
+    BinningAnalysis binning;
+    for (double const value : data) {
+        binning.add(value);
+    }
+    EXPECT_EQ(binning.get_count(), 1024);
+    EXPECT_EQ(binning.get_levels(), 5);
+    EXPECT_NEAR(binning.get_mean(), binned_jackknife(data, 1).mean, 1e-12);
+    for (int level = 0; level < 5; ++level) {
+        EXPECT_NEAR(binning.get_error(level), binned_jackknife(data, 1 << level).error,
+                    1e-12)
+            << level;
+    }
+    EXPECT_TRUE(std::isinf(BinningAnalysis().get_error()));
+}
+
+TEST(statistics, binningAr1) {
+    double const phi = 0.8;
+    std::vector<double> const data = make_ar1(100000, phi, 7);
+    BinningAnalysis binning;
+    for (double const value : data) {
+        binning.add(value);
+    }
+    GammaResult const gamma = gamma_method(data);
+    EXPECT_NEAR(binning.get_error(), gamma.error, 0.2 * gamma.error);
+    EXPECT_NEAR(binning.get_tau_int(), 0.5 * (1 + phi) / (1 - phi), 1.5);
+}
+
+TEST(statistics, binningState) {
+    std::vector<double> const data = make_ar1(1000, 0.5, 8);
+    BinningAnalysis binning;
+    for (int i = 0; i < 500; ++i) {
+        binning.add(data[i]);
+    }
+    std::stringstream state;
+    binning.save_state(state);
+    BinningAnalysis loaded;
+    loaded.load_state(state);
+    for (int i = 500; i < 1000; ++i) {
+        binning.add(data[i]);
+        loaded.add(data[i]);
+    }
+    EXPECT_EQ(loaded.get_count(), binning.get_count());
+    EXPECT_EQ(loaded.get_mean(), binning.get_mean());
+    EXPECT_EQ(loaded.get_error(), binning.get_error());
+}
+
+TEST(statistics, onlineAnalysis) {
+    // The plaquette of a hot start relaxes exponentially, on top of correlated
+    // fluctuations.
+    std::vector<double> const noise = make_ar1(20000, 0.5, 9);
+    OnlineAnalysis analysis;
+    int reached = -1;
+    for (int i = 0; i < 20000; ++i) {
+        analysis.add(0.6 - 0.3 * std::exp(-i / 100.0) + 0.001 * noise[i], 0.01);
+        if (i == OnlineAnalysis::first_check - 2) {
+            EXPECT_FALSE(analysis.is_thermalized());
+        }
+        if (reached < 0 && analysis.has_reached(2e-5)) {
+            reached = i + 1;
+        }
+    }
+    ASSERT_TRUE(analysis.is_thermalized());
+    EXPECT_GE(analysis.get_thermalization(), 500);
+    EXPECT_LE(analysis.get_thermalization(), 3000);
+    EXPECT_EQ(analysis.get_plaquette().get_count(),
+              20000 - analysis.get_thermalization());
+    EXPECT_NEAR(analysis.get_plaquette().get_mean(), 0.6,
+                4 * analysis.get_plaquette().get_error());
+    EXPECT_NEAR(analysis.get_boltzmann().get_mean(), std::exp(-0.01), 1e-12);
+
+    // The error falls as 1/√N, 2e-5 needs several thousand trajectories.
+    EXPECT_GT(reached, 2000);
+    EXPECT_LT(reached, 20000);
+    EXPECT_FALSE(OnlineAnalysis().has_reached(1.0));
+}
+
+TEST(statistics, onlineAnalysisState) {
+    std::vector<double> const noise = make_ar1(2000, 0.5, 10);
+    OnlineAnalysis analysis;
+    for (int i = 0; i < 100; ++i) {
+        analysis.add(0.6 + 0.01 * noise[i], noise[i]);
+    }
+    std::stringstream state;
+    analysis.save_state(state);
+    OnlineAnalysis loaded;
+    loaded.load_state(state);
+    for (int i = 100; i < 2000; ++i) {
+        analysis.add(0.6 + 0.01 * noise[i], noise[i]);
+        loaded.add(0.6 + 0.01 * noise[i], noise[i]);
+    }
+    ASSERT_TRUE(loaded.is_thermalized());
+    EXPECT_EQ(loaded.get_thermalization(), analysis.get_thermalization());
+    EXPECT_EQ(loaded.get_plaquette().get_error(), analysis.get_plaquette().get_error());
+    EXPECT_EQ(loaded.get_boltzmann().get_mean(), analysis.get_boltzmann().get_mean());
+}
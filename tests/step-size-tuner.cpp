@@ -0,0 +1,128 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../step-size-tuner.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+/**
+  Energy difference of a second order integrator, the variance of ΔH grows with
+  the fourth power of the step size. The mean is half the variance, such that
+  ⟨exp(−ΔH)⟩ = 1.
+  */
+double draw_energy_difference(double const time_step, std::mt19937 &engine) {
+    double const variance = std::pow(time_step / 0.1, 4);
+    std::normal_distribution<double> dist(0.5 * variance, std::sqrt(variance));
+    return dist(engine);
+}
+
+/**
+  Mean acceptance probability at the given step size.
+  */
+double get_acceptance(double const time_step) {
+    std::mt19937 engine(0);
+    double sum = 0.0;
+    int const samples = 100000;
+    for (int i = 0; i < samples; ++i) {
+        sum += std::min(1.0, std::exp(-draw_energy_difference(time_step, engine)));
+    }
+    return sum / samples;
+}
+}  // namespace
+
+TEST(stepSizeTuner, invalidArguments) {
+    EXPECT_THROW(StepSizeTuner(0.1, 10, 0.0, false), std::invalid_argument);
+    EXPECT_THROW(StepSizeTuner(0.1, 10, 1.0, false), std::invalid_argument);
+    EXPECT_THROW(StepSizeTuner(0.0, 10, 0.8, false), std::invalid_argument);
+    EXPECT_THROW(StepSizeTuner(0.1, 0, 0.8, false), std::invalid_argument);
+}
+
+TEST(stepSizeTuner, reachesTarget) {
+    // Both a too small and a too large initial step size are corrected.
+    for (double const initial : {0.01, 0.5}) {
+        StepSizeTuner tuner(initial, 10, 0.8, false);
+        std::mt19937 engine(1);
+        for (int i = 0; i < 500; ++i) {
+            tuner.update(draw_energy_difference(tuner.get_time_step(), engine));
+        }
+        tuner.freeze();
+        EXPECT_EQ(tuner.get_steps(), 10);
+        EXPECT_NEAR(get_acceptance(tuner.get_time_step()), 0.8, 0.05) << initial;
+    }
+}
+
+TEST(stepSizeTuner, fixedLength) {
+    StepSizeTuner tuner(0.05, 20, 0.8, true);
+    std::mt19937 engine(2);
+    for (int i = 0; i < 500; ++i) {
+        tuner.update(draw_energy_difference(tuner.get_time_step(), engine));
+        ASSERT_NEAR(tuner.get_time_step() * tuner.get_steps(), 1.0, 1e-12);
+    }
+    tuner.freeze();
+    EXPECT_NEAR(tuner.get_time_step() * tuner.get_steps(), 1.0, 1e-12);
+    EXPECT_LT(tuner.get_steps(), 20);
+    EXPECT_NEAR(get_acceptance(tuner.get_time_step()), 0.8, 0.1);
+}
+
+TEST(stepSizeTuner, boundedAfterRejections) {
+    // Rejections from a hot start must not make the trajectories arbitrarily long.
+    StepSizeTuner tuner(0.1, 10, 0.8, true);
+    for (int i = 0; i < 20; ++i) {
+        tuner.update(std::numeric_limits<double>::infinity());
+        ASSERT_LE(tuner.get_steps(), 100) << i;
+        ASSERT_NEAR(tuner.get_time_step() * tuner.get_steps(), 1.0, 1e-12);
+    }
+    tuner.freeze();
+    EXPECT_LE(tuner.get_steps(), 100);
+
+    // Likewise the step size does not grow without limit.
+    StepSizeTuner growing(0.1, 10, 0.8, false);
+    for (int i = 0; i < 20; ++i) {
+        growing.update(-1.0);
+        ASSERT_LE(growing.get_time_step(), 1.0 + 1e-12) << i;
+    }
+}
+
+TEST(stepSizeTuner, frozen) {
+    StepSizeTuner tuner(0.1, 10, 0.8, false);
+    tuner.update(0.5);
+    tuner.update(std::numeric_limits<double>::quiet_NaN());
+    EXPECT_EQ(tuner.get_count(), 2);
+    EXPECT_NEAR(tuner.get_acceptance(), 0.5 * std::exp(-0.5), 1e-15);
+
+    tuner.freeze();
+    ASSERT_TRUE(tuner.is_frozen());
+    double const time_step = tuner.get_time_step();
+    tuner.update(10.0);
+    EXPECT_EQ(tuner.get_time_step(), time_step);
+    EXPECT_EQ(tuner.get_count(), 2);
+}
+
+TEST(stepSizeTuner, state) {
+    StepSizeTuner tuner(0.1, 10, 0.8, false);
+    std::mt19937 engine(3);
+    for (int i = 0; i < 50; ++i) {
+        tuner.update(draw_energy_difference(tuner.get_time_step(), engine));
+    }
+    std::stringstream state;
+    tuner.save_state(state);
+    StepSizeTuner loaded(0.1, 10, 0.8, false);
+    loaded.load_state(state);
+    for (int i = 0; i < 50; ++i) {
+        double const energy_difference =
+            draw_energy_difference(tuner.get_time_step(), engine);
+        tuner.update(energy_difference);
+        loaded.update(energy_difference);
+    }
+    tuner.freeze();
+    loaded.freeze();
+    EXPECT_EQ(loaded.get_time_step(), tuner.get_time_step());
+    EXPECT_EQ(loaded.get_count(), 100);
+}
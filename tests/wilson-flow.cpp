@@ -0,0 +1,159 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../wilson-flow.hpp"
+
+#include "../hybrid-monte-carlo.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+double const pi = std::acos(-1);
+
+Quaternion rotation(double const angle) {
+    return Quaternion(std::cos(angle), 0.0, 0.0, std::sin(angle));
+}
+
+/**
+  Abelian field with constant plaquette angles 2π n_{01} / (L_0 L_1) and 2π n_{23}
+  / (L_2 L_3) in the planes (0, 1) and (2, 3).
+  */
+Configuration make_constant_field(int const length, int const n01, int const n23) {
+    Configuration links(length, length);
+    double const phi01 = 2 * pi * n01 / (length * length);
+    double const phi23 = 2 * pi * n23 / (length * length);
+    for (int x0 = 0; x0 < length; ++x0) {
+        for (int x1 = 0; x1 < length; ++x1) {
+            for (int x2 = 0; x2 < length; ++x2) {
+                for (int x3 = 0; x3 < length; ++x3) {
+                    int const site = links.get_site(x0, x1, x2, x3);
+                    links(site, 0) = rotation(-phi01 * x1);
+                    links(site, 1) =
+                        rotation(x1 == length - 1 ? phi01 * length * x0 : 0.0);
+                    links(site, 2) = rotation(-phi23 * x3);
+                    links(site, 3) =
+                        rotation(x3 == length - 1 ? phi23 * length * x2 : 0.0);
+                }
+            }
+        }
+    }
+    return links;
+}
+}  // namespace
+
+TEST(wilsonFlow, identity) {
+    Configuration links(4, 4);
+    for (int i = 0; i < links.get_size(); ++i) {
+        links[i] = Quaternion::identity();
+    }
+    CloverObservables const clover = measure_clover(links);
+    EXPECT_NEAR(clover.energy_density, 0.0, 1e-15);
+    EXPECT_NEAR(clover.topological_charge, 0.0, 1e-15);
+
+    WilsonFlow flow(4, 4, 0.1);
+    flow.flow(links, 1.0);
+    EXPECT_EQ(flow.get_steps_accepted(), 10);
+    for (int i = 0; i < links.get_size(); ++i) {
+        EXPECT_NEAR(links[i][0], 1.0, 1e-15);
+    }
+}
+
+TEST(wilsonFlow, constantField) {
+    int const length = 8;
+    double const phi = 2 * pi / (length * length);
+    for (int sign : {1, -1}) {
+        Configuration const links = make_constant_field(length, 1, sign * 2);
+        CloverObservables const clover = measure_clover(links);
+        double const expected_charge = links.get_volume() * 16 * std::sin(phi) *
+                                       std::sin(sign * 2 * phi) / (32 * pi * pi);
+        EXPECT_NEAR(clover.topological_charge, expected_charge, 1e-10);
+        EXPECT_NEAR(clover.topological_charge, sign * 4, 0.05);
+        EXPECT_NEAR(clover.energy_density,
+                    2 * (std::pow(std::sin(phi), 2) + std::pow(std::sin(2 * phi), 2)),
+                    1e-12);
+
+        // The plaquette definition agrees up to terms of order φ⁴.
+        double const plaquette = get_plaquette_trace_average(links).real();
+        EXPECT_NEAR(
+            clover.energy_density, 24 * (1 - plaquette), 1e-2 * 24 * (1 - plaquette));
+    }
+}
+
+TEST(wilsonFlow, heatEquation) {
+    // A small transverse abelian mode decays like exp(-p̂² t) with the lattice
+    // momentum p̂² = 4 sin²(p / 2).
+    int const length_time = 8;
+    double const amplitude = 1e-5;
+    double const momentum = 2 * pi / length_time;
+    Configuration links(4, length_time);
+    for (int site = 0; site < links.get_volume(); ++site) {
+        int const x0 = site / (4 * 4 * 4);
+        for (int mu = 0; mu < 4; ++mu) {
+            links(site, mu) = mu == 1 ? rotation(amplitude * std::cos(momentum * x0))
+                                      : Quaternion::identity();
+        }
+    }
+
+    double const flow_time = 0.7;
+    WilsonFlow flow(4, length_time, 0.05);
+    flow.flow(links, flow_time);
+
+    double const decay = std::exp(-4 * std::pow(std::sin(momentum / 2), 2) * flow_time);
+    for (int x0 = 0; x0 < length_time; ++x0) {
+        double const angle = log(links(links.get_site(x0, 1, 2, 3), 1))[3];
+        EXPECT_NEAR(
+            angle, amplitude * std::cos(momentum * x0) * decay, 1e-5 * amplitude);
+    }
+}
+
+TEST(wilsonFlow, adaptive) {
+    Configuration const links = make_hot_start(4, 4, 0.5, 3);
+
+    Configuration fine = links;
+    WilsonFlow reference(4, 4, 0.005);
+    reference.flow(fine, 0.5);
+
+    Configuration adaptive = links;
+    WilsonFlow flow(4, 4, 0.2, 1e-4);
+    flow.flow(adaptive, 0.5);
+    EXPECT_GT(flow.get_steps_rejected(), 0);
+    EXPECT_LT(flow.get_steps_accepted(), 50);
+
+    double deviation = 0.0;
+    for (int i = 0; i < links.get_size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            deviation = std::max(deviation, std::abs(adaptive[i][c] - fine[i][c]));
+        }
+    }
+    EXPECT_LT(deviation, 1e-4);
+
+    // The flow smoothens, the action decreases.
+    EXPECT_GT(get_plaquette_trace_average(adaptive).real(),
+              get_plaquette_trace_average(links).real() + 0.1);
+    EXPECT_LT(measure_clover(adaptive).energy_density,
+              measure_clover(links).energy_density);
+
+    EXPECT_THROW(WilsonFlow(4, 4, 0.0), std::invalid_argument);
+    EXPECT_THROW(WilsonFlow(4, 4, 0.1, -1.0), std::invalid_argument);
+}
+
+TEST(wilsonFlow, adaptiveFailure) {
+    Configuration const links = make_hot_start(4, 4, 0.5, 3);
+
+#ifdef NDEBUG
+    // With assertions the generator of the flow already stops the program.
+    Configuration diverged = links;
+    diverged(0, 0) = Quaternion(std::nan(""), 0.0, 0.0, 0.0);
+    WilsonFlow flow(4, 4, 0.2, 1e-4);
+    EXPECT_THROW(flow.flow(diverged, 0.5), std::runtime_error);
+#endif
+
+    // The rounding errors alone exceed this tolerance.
+    Configuration unreachable = links;
+    WilsonFlow strict(4, 4, 0.2, 1e-300);
+    EXPECT_THROW(strict.flow(unreachable, 0.5), std::runtime_error);
+    EXPECT_EQ(strict.get_steps_accepted(), 0);
+}
@@ -0,0 +1,101 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "../wilson-loops.hpp"
+
+#include "../hybrid-monte-carlo.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+namespace {
+Quaternion get_line(Configuration const &links,
+                    int const site,
+                    int const mu,
+                    int const length,
+                    int &end) {
+    Quaternion product = Quaternion::identity();
+    end = site;
+    for (int i = 0; i < length; ++i) {
+        product = product * links(end, mu);
+        end = links.get_neighbors().forward(end, mu);
+    }
+    return product;
+}
+
+/// Every loop formed from scratch, to compare with.
+double get_wilson_loop(Configuration const &links, int const r, int const t) {
+    double sum = 0.0;
+    for (int site = 0; site < links.get_volume(); ++site) {
+        for (int i = 1; i < 4; ++i) {
+            int corner_r, corner_t, end;
+            Quaternion const bottom = get_line(links, site, i, r, corner_r);
+            Quaternion const right = get_line(links, corner_r, 0, t, end);
+            Quaternion const left = get_line(links, site, 0, t, corner_t);
+            Quaternion const top = get_line(links, corner_t, i, r, end);
+            sum += 0.5 * (bottom * right * top.adjoint() * left.adjoint()).trace();
+        }
+    }
+    return sum / (3 * links.get_volume());
+}
+}  // namespace
+
+TEST(wilsonLoops, matchesDirectComputation) {
+    Configuration const links = make_hot_start(4, 6, 0.3, 1);
+    WilsonLoopEngine engine(4, 6, 3, 5);
+    auto const loops = engine.measure(links);
+    ASSERT_EQ(loops.size(), 3 * 5);
+    for (int r = 1; r <= 3; ++r) {
+        for (int t = 1; t <= 5; ++t) {
+            EXPECT_NEAR(loops[(r - 1) * 5 + t - 1], get_wilson_loop(links, r, t), 1e-13)
+                << r << "×" << t;
+        }
+    }
+
+    // The scratch fields are reused.
+    Configuration const other = make_hot_start(4, 6, 0.3, 2);
+    EXPECT_NEAR(engine.measure(other)[7], get_wilson_loop(other, 2, 3), 1e-13);
+    EXPECT_NEAR(engine.measure(links)[0], get_wilson_loop(links, 1, 1), 1e-13);
+}
+
+TEST(wilsonLoops, sizes) {
+    EXPECT_THROW(WilsonLoopEngine(4, 6, 0, 1), std::invalid_argument);
+    EXPECT_THROW(WilsonLoopEngine(4, 6, 5, 1), std::invalid_argument);
+    EXPECT_THROW(WilsonLoopEngine(4, 6, 4, 7), std::invalid_argument);
+    EXPECT_NO_THROW(WilsonLoopEngine(4, 6, 4, 6));
+}
+
+TEST(wilsonLoops, polyakovCorrelator) {
+    Configuration const links = make_hot_start(4, 6, 0.3, 1);
+    auto const loops = get_polyakov_loops(links);
+    ASSERT_EQ(loops.size(), 4 * 4 * 4);
+
+    // Direct computation at the spatial site (n2, n3, n4) = (1, 2, 3).
+    int end;
+    int const site = links.get_site(0, 1, 2, 3);
+    EXPECT_NEAR(loops[site], 0.5 * get_line(links, site, 0, 6, end).trace(), 1e-14);
+    EXPECT_EQ(end, site);
+
+    auto const correlator = get_polyakov_correlator(links, 4);
+    ASSERT_EQ(correlator.size(), 5);
+    double squares = 0.0;
+    for (double const loop : loops) {
+        squares += loop * loop;
+    }
+    EXPECT_NEAR(correlator[0], squares / loops.size(), 1e-14);
+    // Periodic in the spatial extent.
+    EXPECT_NEAR(correlator[4], correlator[0], 1e-14);
+
+    double expected = 0.0;
+    for (int n2 = 0; n2 < 4; ++n2) {
+        for (int n3 = 0; n3 < 4; ++n3) {
+            for (int n4 = 0; n4 < 4; ++n4) {
+                double const p = loops[links.get_site(0, n2, n3, n4)];
+                expected += p * (loops[links.get_site(0, n2 + 1, n3, n4)] +
+                                 loops[links.get_site(0, n2, n3 + 1, n4)] +
+                                 loops[links.get_site(0, n2, n3, n4 + 1)]);
+            }
+        }
+    }
+    EXPECT_NEAR(correlator[1], expected / (3 * loops.size()), 1e-14);
+}
@@ -0,0 +1,229 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "wilson-flow.hpp"
+
+#include "hybrid-monte-carlo.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/**
+  Imaginary part \f$ \vec q \f$ of the sum \f$ Q = q_0 + i \vec q \cdot \vec \sigma
+  \f$ of the four plaquettes in the plane (mu, nu) that start and end at the site.
+  */
+Quaternion get_clover(int const site,
+                      int const mu,
+                      int const nu,
+                      Configuration const &links) {
+    NeighborTable const &neighbors = links.get_neighbors();
+    int const plus_mu = neighbors.forward(site, mu);
+    int const plus_nu = neighbors.forward(site, nu);
+    int const minus_mu = neighbors.backward(site, mu);
+    int const minus_nu = neighbors.backward(site, nu);
+    int const minus_mu_minus_nu = neighbors.backward(minus_mu, nu);
+    int const minus_mu_plus_nu = neighbors.diagonal(site, nu, mu);
+    int const plus_mu_minus_nu = neighbors.diagonal(site, mu, nu);
+
+    Quaternion clover = links(site, mu) * links(plus_mu, nu) *
+                        links(plus_nu, mu).adjoint() * links(site, nu).adjoint();
+    clover += links(site, nu) * links(minus_mu_plus_nu, mu).adjoint() *
+              links(minus_mu, nu).adjoint() * links(minus_mu, mu);
+    clover += links(minus_mu, mu).adjoint() * links(minus_mu_minus_nu, nu).adjoint() *
+              links(minus_mu_minus_nu, mu) * links(minus_nu, nu);
+    clover += links(minus_nu, nu).adjoint() * links(minus_nu, mu) *
+              links(plus_mu_minus_nu, nu) * links(site, mu).adjoint();
+    return clover;
+}
+
+double dot(Quaternion const &a, Quaternion const &b) {
+    return a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+}
+
+double get_distance(Quaternion const &a, Quaternion const &b) {
+    double sum = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+    }
+    return std::sqrt(sum);
+}
+
+/// The adaptive step size does not go below this, a smaller one means that the
+/// flow does not converge.
+double const minimum_step = 1e-8;
+}  // namespace
+
+Algebra get_flow_generator(int const site, int const mu, Configuration const &links) {
+    // The flow is the steepest descent of g_0^2 S = 2 Σ_p Re tr(1 - U_p), which is
+    // the Wilson action at β = 2 N. The force of the molecular dynamics is half of
+    // the gradient in these coordinates, so β = N gives the flow.
+    return get_momentum_derivative(links(site, mu) * get_staples(site, mu, links),
+                                   number_of_colors);
+}
+
+CloverObservables measure_clover(Configuration const &links) {
+    // With Q = q_0 + i q·σ the field strength is G = (Q - Q^†) / 8 = i q·σ / 4. Then
+    // E = -1/2 Σ tr(G G) = Σ_{μ<ν} q·q / 8 and ε tr(G G) sums to -(q01·q23 -
+    // q02·q13 + q03·q12).
+    double energy_sum = 0.0;
+    double const charge_sum = parallel_sum([&](double &partial) {
+        double energy_partial = 0.0;
+#pragma omp for schedule(static)
+        for (int site = 0; site < links.get_volume(); ++site) {
+            Quaternion const q01 = get_clover(site, 0, 1, links);
+            Quaternion const q02 = get_clover(site, 0, 2, links);
+            Quaternion const q03 = get_clover(site, 0, 3, links);
+            Quaternion const q12 = get_clover(site, 1, 2, links);
+            Quaternion const q13 = get_clover(site, 1, 3, links);
+            Quaternion const q23 = get_clover(site, 2, 3, links);
+
+            energy_partial += dot(q01, q01) + dot(q02, q02) + dot(q03, q03) +
+                              dot(q12, q12) + dot(q13, q13) + dot(q23, q23);
+            partial += dot(q01, q23) - dot(q02, q13) + dot(q03, q12);
+        }
+        double const energy = team_sum(energy_partial);
+#pragma omp master
+        energy_sum = energy;
+    });
+
+    double const pi = std::acos(-1);
+    CloverObservables result;
+    result.energy_density = energy_sum / (8.0 * links.get_volume());
+    result.topological_charge = charge_sum / (32 * pi * pi);
+    return result;
+}
+
+WilsonFlow::WilsonFlow(int const length_space,
+                       int const length_time,
+                       double const step,
+                       double const tolerance)
+    : step(step),
+      tolerance(tolerance),
+      steps_accepted(0),
+      steps_rejected(0),
+      generators(length_space, length_time) {
+    if (!(step > 0.0) || !(tolerance >= 0.0)) {
+        throw std::invalid_argument(
+            "The flow needs a positive step size and a non-negative tolerance.");
+    }
+    if (tolerance > 0.0) {
+        second_order.reset(new Configuration(length_space, length_time));
+        backup.reset(new Configuration(length_space, length_time));
+    }
+}
+
+void WilsonFlow::flow(Configuration &links, double const flow_time) {
+    double remaining = flow_time;
+    while (remaining > 0.0) {
+        // Avoid a tiny last step from rounding.
+        bool const last = step >= remaining * (1 - 1e-10);
+        double const size = last ? remaining : step;
+
+        if (tolerance == 0.0) {
+            try_step(links, size);
+            ++steps_accepted;
+            remaining -= size;
+            continue;
+        }
+
+        *backup = links;
+        double const deviation = try_step(links, size);
+        if (!std::isfinite(deviation)) {
+            links = *backup;
+            throw std::runtime_error("The Wilson flow diverged, the links are not finite.");
+        }
+
+        // The local error of the second order solution scales with the third power
+        // of the step size.
+        double const factor =
+            std::min(2.0, std::max(0.2, 0.95 * std::cbrt(tolerance / deviation)));
+        if (deviation <= tolerance) {
+            ++steps_accepted;
+            remaining -= size;
+            // A shortened last step says nothing about the step size that fits.
+            if (!last || factor < 1.0) {
+                step = size * factor;
+            }
+        } else {
+            ++steps_rejected;
+            links = *backup;
+            step = size * factor;
+            if (step < minimum_step) {
+                throw std::runtime_error(
+                    "The Wilson flow needs a step size below the minimum to reach "
+                    "the tolerance.");
+            }
+        }
+    }
+}
+
+double WilsonFlow::try_step(Configuration &links, double const size) {
+    // Lüscher's scheme with the generators Z_i = ε Z(W_i):
+    //   W_1 = exp(1/4 Z_0) W_0
+    //   W_2 = exp(8/9 Z_1 - 17/36 Z_0) W_1
+    //   W_3 = exp(3/4 Z_2 - 8/9 Z_1 + 17/36 Z_0) W_2
+    // Only the exponent is stored, each one follows from the previous as
+    // X_0 = 1/4 Z_0, X_1 = 8/9 Z_1 - 17/9 X_0 and X_2 = 3/4 Z_2 - X_1. The second
+    // order solution with the same first two stages is exp(2 Z_1 - 5 X_0) W_1.
+    double const coefficients[3] = {0.25, 8.0 / 9.0, 0.75};
+    double const previous[3] = {0.0, -17.0 / 9.0, -1.0};
+    bool const adaptive = second_order != nullptr;
+    int const volume = links.get_volume();
+
+    double deviation = 0.0;
+    parallel_region([&]() {
+        for (int stage = 0; stage < 3; ++stage) {
+#pragma omp for schedule(static)
+            for (int site = 0; site < volume; ++site) {
+                for (int mu = 0; mu < 4; ++mu) {
+                    Algebra const generator =
+                        size * get_flow_generator(site, mu, links);
+                    Algebra &sum = generators(site, mu);
+                    if (adaptive && stage == 1) {
+                        Algebra const exponent = 2.0 * generator + (-5.0) * sum;
+                        (*second_order)(site, mu) =
+                            exp(exponent.times_imag_unit()) * links(site, mu);
+                    }
+                    if (stage == 0) {
+                        sum = coefficients[stage] * generator;
+                    } else {
+                        sum *= previous[stage];
+                        sum += coefficients[stage] * generator;
+                    }
+                }
+            }
+
+            // The generators of all links have to be known before the links change.
+#pragma omp for schedule(static)
+            for (int site = 0; site < volume; ++site) {
+                for (int mu = 0; mu < 4; ++mu) {
+                    links(site, mu) =
+                        exp(generators(site, mu).times_imag_unit()) * links(site, mu);
+                }
+            }
+        }
+
+        if (adaptive) {
+            double partial = 0.0;
+#pragma omp for schedule(static)
+            for (int site = 0; site < volume; ++site) {
+                for (int mu = 0; mu < 4; ++mu) {
+                    double const distance =
+                        get_distance(links(site, mu), (*second_order)(site, mu));
+                    // The maximum would drop a NaN, it is counted as infinite.
+                    partial = std::max(partial, std::isnan(distance)
+                                                    ? std::numeric_limits<double>::infinity()
+                                                    : distance);
+                }
+            }
+            double const maximum = team_max(partial);
+#pragma omp master
+            deviation = maximum;
+        }
+    });
+    return deviation;
+}
@@ -0,0 +1,114 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Wilson gradient flow and the clover observables measured along it.
+///
+/// Lüscher, “Properties and uses of the Wilson flow in lattice QCD”, JHEP 08 (2010)
+/// 071.
+
+#pragma once
+
+#include "configuration.hpp"
+
+#include <memory>
+
+/**
+  Generator \f$ Z_\mu(x) \f$ of the Wilson flow \f$ \dot V = Z(V) V \f$ for one
+  link, in the convention of the momenta: the link is updated as \f$ \exp(i
+  \epsilon Z) V \f$.
+
+  This is the force of the molecular dynamics at β = N, the gradient of
+  \f$ g_0^2 S \f$.
+  */
+Algebra get_flow_generator(int const site, int const mu, Configuration const &links);
+
+/**
+  Clover field strength observables of a configuration.
+  */
+struct CloverObservables {
+    /// \f$ \langle E \rangle = \frac14 \langle G^a_{\mu\nu} G^a_{\mu\nu} \rangle \f$
+    /// averaged over the sites, in lattice units.
+    double energy_density;
+
+    /// \f$ Q = \sum_x \frac{1}{32 \pi^2} \epsilon_{\mu\nu\rho\sigma} G^a_{\mu\nu}
+    /// G^a_{\rho\sigma} \f$.
+    double topological_charge;
+};
+
+/**
+  Computes the energy density and the topological charge from the clover
+  definition of the field strength, the average of the four plaquettes around a
+  site in each plane.
+  */
+CloverObservables measure_clover(Configuration const &links);
+
+/**
+  Integrator for the Wilson flow with Lüscher's third order Runge–Kutta scheme.
+
+  The links are evolved in place. One step needs one temporary field for the
+  generators, which are accumulated in the low-storage form of the scheme. With a
+  tolerance the step size is adapted: a second order solution from the first two
+  stages is formed alongside, and a step is repeated with a smaller size if the
+  two differ by more than the tolerance in any link. This needs two more fields
+  for the second order solution and the links at the start of the step.
+
+  All fields are allocated by the constructor, flowing does not allocate. The
+  sweeps share the sites among the OpenMP threads.
+  */
+class WilsonFlow {
+  public:
+    /**
+      \param step Step size, the initial one if adaptive.
+      \param tolerance Maximum deviation of a link between the third and second
+      order solution in one step, zero for a fixed step size.
+
+      \throws std::invalid_argument for a step size that is not positive or a
+      negative tolerance.
+      */
+    WilsonFlow(int const length_space,
+               int const length_time,
+               double const step,
+               double const tolerance = 0.0);
+
+    /**
+      Flows the links by the given flow time, the last step is shortened to end
+      there exactly.
+
+      \throws std::runtime_error if adaptive and a step gives links that are not
+      finite, or the step size has to go below 1e-8 to reach the tolerance. The
+      links are then those after the last accepted step.
+      */
+    void flow(Configuration &links, double const flow_time);
+
+    /**
+      Step size that is used next.
+      */
+    double get_step() const { return step; }
+
+    /**
+      Resets the step size, for instance to start every configuration alike.
+      */
+    void set_step(double const new_step) { step = new_step; }
+
+    int get_steps_accepted() const { return steps_accepted; }
+    int get_steps_rejected() const { return steps_rejected; }
+
+  private:
+    /**
+      One step of the given size, returns the maximum deviation from the second
+      order solution if adaptive.
+      */
+    double try_step(Configuration &links, double const size);
+
+    double step;
+    double tolerance;
+
+    int steps_accepted;
+    int steps_rejected;
+
+    MomentumConfiguration generators;
+
+    /// Only allocated with a tolerance.
+    std::unique_ptr<Configuration> second_order;
+    std::unique_ptr<Configuration> backup;
+};
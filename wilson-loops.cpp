@@ -0,0 +1,160 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+#include "wilson-loops.hpp"
+
+#include "parallel.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+/**
+  Runs `body(partial)` on all threads of the current team or of a new one and
+  returns the element-wise sums of the per-thread vectors `partial`.
+  */
+template <typename Body>
+std::vector<double> parallel_sums(int const size, Body const &body) {
+    std::vector<double> result(size);
+    parallel_region([&]() {
+        std::vector<double> partial(size, 0.0);
+        body(partial);
+        for (int i = 0; i < size; ++i) {
+            double const sum = team_sum(partial[i]);
+#pragma omp master
+            result[i] = sum;
+        }
+    });
+    return result;
+}
+}  // namespace
+
+WilsonLoopEngine::WilsonLoopEngine(int const length_space,
+                                   int const length_time,
+                                   int const r_max,
+                                   int const t_max)
+    : length_space(length_space),
+      length_time(length_time),
+      volume(length_space * length_space * length_space * length_time),
+      r_max(r_max),
+      t_max(t_max),
+      temporal_lines(static_cast<size_t>(t_max) * volume),
+      time_shifted(static_cast<size_t>(t_max) * volume),
+      spatial_line(volume),
+      spatial_end(volume) {
+    if (r_max < 1 || t_max < 1 || r_max > length_space || t_max > length_time) {
+        throw std::invalid_argument(
+            "Wilson loops need 1 ≤ r_max ≤ length_space and 1 ≤ t_max ≤ length_time.");
+    }
+
+    auto const neighbors = NeighborTable::get(length_space, length_time);
+    for (int site = 0; site < volume; ++site) {
+        int shifted = site;
+        for (int t = 0; t < t_max; ++t) {
+            shifted = neighbors->forward(shifted, 0);
+            time_shifted[t * volume + site] = shifted;
+        }
+    }
+}
+
+std::vector<double> WilsonLoopEngine::measure(Configuration const &links) {
+    assert(links.length_space == length_space && links.length_time == length_time);
+    auto const sums = parallel_sums(r_max * t_max, [&](std::vector<double> &partial) {
+        // Temporal lines of all lengths, each one extends the previous by a link.
+#pragma omp for schedule(static)
+        for (int site = 0; site < volume; ++site) {
+            temporal_lines[site] = links(site, 0);
+            for (int t = 1; t < t_max; ++t) {
+                temporal_lines[t * volume + site] =
+                    temporal_lines[(t - 1) * volume + site] *
+                    links(time_shifted[(t - 1) * volume + site], 0);
+            }
+        }
+
+        NeighborTable const &neighbors = links.get_neighbors();
+        for (int i = 1; i < 4; ++i) {
+            for (int r = 1; r <= r_max; ++r) {
+                // Extending the lines needs no neighbors, the loops below read the
+                // lines of other sites.
+#pragma omp for schedule(static)
+                for (int site = 0; site < volume; ++site) {
+                    if (r == 1) {
+                        spatial_line[site] = links(site, i);
+                        spatial_end[site] = neighbors.forward(site, i);
+                    } else {
+                        spatial_line[site] =
+                            spatial_line[site] * links(spatial_end[site], i);
+                        spatial_end[site] = neighbors.forward(spatial_end[site], i);
+                    }
+                }
+
+#pragma omp for schedule(static)
+                for (int site = 0; site < volume; ++site) {
+                    Quaternion const &bottom = spatial_line[site];
+                    int const end = spatial_end[site];
+                    for (int t = 1; t <= t_max; ++t) {
+                        size_t const offset = static_cast<size_t>(t - 1) * volume;
+                        Quaternion const &right = temporal_lines[offset + end];
+                        Quaternion const &top =
+                            spatial_line[time_shifted[offset + site]];
+                        Quaternion const &left = temporal_lines[offset + site];
+                        partial[(r - 1) * t_max + t - 1] +=
+                            (bottom * right * top.adjoint() * left.adjoint()).trace();
+                    }
+                }
+            }
+        }
+    });
+
+    // The trace is twice the real part, there are three spatial directions.
+    std::vector<double> result(sums.size());
+    for (size_t i = 0; i < sums.size(); ++i) {
+        result[i] = sums[i] / (2.0 * 3 * volume);
+    }
+    return result;
+}
+
+std::vector<double> get_polyakov_loops(Configuration const &links) {
+    // The time coordinate runs slowest, so the sites of the first time slice come
+    // first.
+    int const spatial_volume = links.get_volume() / links.length_time;
+    NeighborTable const &neighbors = links.get_neighbors();
+    std::vector<double> loops(spatial_volume);
+    parallel_region([&]() {
+#pragma omp for schedule(static)
+        for (int site = 0; site < spatial_volume; ++site) {
+            Quaternion product = links(site, 0);
+            int shifted = neighbors.forward(site, 0);
+            for (int t = 1; t < links.length_time; ++t) {
+                product = product * links(shifted, 0);
+                shifted = neighbors.forward(shifted, 0);
+            }
+            loops[site] = 0.5 * product.trace();
+        }
+    });
+    return loops;
+}
+
+std::vector<double> get_polyakov_correlator(Configuration const &links, int const r_max) {
+    std::vector<double> const loops = get_polyakov_loops(links);
+    int const spatial_volume = loops.size();
+    NeighborTable const &neighbors = links.get_neighbors();
+
+    auto sums = parallel_sums(r_max + 1, [&](std::vector<double> &partial) {
+#pragma omp for schedule(static)
+        for (int site = 0; site < spatial_volume; ++site) {
+            for (int i = 1; i < 4; ++i) {
+                // Spatial steps stay in the first time slice.
+                int shifted = site;
+                for (int r = 0; r <= r_max; ++r) {
+                    partial[r] += loops[site] * loops[shifted];
+                    shifted = neighbors.forward(shifted, i);
+                }
+            }
+        }
+    });
+
+    for (auto &sum : sums) {
+        sum /= 3.0 * spatial_volume;
+    }
+    return sums;
+}
@@ -0,0 +1,73 @@
+// Copyright © 2016 Martin Ueding <dev@martin-ueding.de>
+
+/// \file
+/// Rectangular Wilson loops and Polyakov loop correlators for the static potential.
+
+#pragma once
+
+#include "configuration.hpp"
+
+#include <vector>
+
+/**
+  Computes all planar R×T Wilson loops up to a maximum size in one pass.
+
+  The temporal lines \f$ L_T(x) = U_0(x) U_0(x + \hat 0) \cdots U_0(x + (T-1) \hat
+  0) \f$ are formed for all T once and cached. For every spatial direction the
+  spatial line is then extended by one link at a time, and with each length R the
+  loops of all T are closed with three multiplications:
+
+  \f[ W(R, T)(x) = S_R(x) L_T(x + R \hat\imath) S_R(x + T \hat 0)^\dagger
+      L_T(x)^\dagger \f]
+
+  The scratch fields are kept between calls, such that an engine can be reused for
+  all configurations of a run. The sweeps share the sites among the OpenMP threads.
+  */
+class WilsonLoopEngine {
+  public:
+    /**
+      \throws std::invalid_argument if the sizes are smaller than one or larger
+      than the lattice.
+      */
+    WilsonLoopEngine(int const length_space,
+                     int const length_time,
+                     int const r_max,
+                     int const t_max);
+
+    /**
+      Averages of \f$ \frac12 \operatorname{tr} W(R, T) \f$ over all sites and
+      spatial directions, T running fastest: W(1, 1), W(1, 2), …, W(1, t_max),
+      W(2, 1), …
+      */
+    std::vector<double> measure(Configuration const &links);
+
+    int get_r_max() const { return r_max; }
+    int get_t_max() const { return t_max; }
+
+  private:
+    int length_space, length_time, volume;
+    int r_max, t_max;
+
+    /// Temporal lines, `temporal_lines[(T - 1) * volume + site]`.
+    std::vector<Quaternion> temporal_lines;
+
+    /// Sites \f$ x + T \hat 0 \f$, `time_shifted[(T - 1) * volume + site]`.
+    std::vector<int> time_shifted;
+
+    /// Spatial line of the current length and the site at its end.
+    std::vector<Quaternion> spatial_line;
+    std::vector<int> spatial_end;
+};
+
+/**
+  Polyakov loops \f$ \frac12 \operatorname{tr} \prod_t U_0(t, \vec x) \f$ for every
+  spatial site, in the order of the sites of the first time slice.
+  */
+std::vector<double> get_polyakov_loops(Configuration const &links);
+
+/**
+  On-axis correlator \f$ \langle P(\vec x) P(\vec x + r \hat\imath) \rangle \f$ of
+  the Polyakov loops for r = 0, …, `r_max`, averaged over the sites and the three
+  spatial directions.
+  */
+std::vector<double> get_polyakov_correlator(Configuration const &links, int const r_max);